@@ -18,6 +18,11 @@
 #include <signal.h>
 #include <curses.h>
 #include <assert.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/ioctl.h>
 #include "cab202_graphics.h"
 #include "cab202_timers.h"
 
@@ -30,6 +35,7 @@
 FILE * zdk_save_stream = NULL;
 FILE * zdk_input_stream = NULL;
 bool zdk_suppress_output = false;
+bool zdk_null_render = false;
 
 // Private helper functions.
 static void save_screen_(FILE * f);
@@ -49,6 +55,43 @@ static void save_char(int char_code);
 Screen * zdk_screen = NULL;
 Screen * zdk_prev_screen = NULL;
 
+/*
+ *	Layered rendering. Each layer is an off-screen buffer in which '\0'
+ *	denotes a transparent cell. The cells which hold content are listed
+ *	so that clear_layer only visits what was drawn.
+ *
+ *	Cells of zdk_screen which have been recomposited since the last call
+ *	to show_screen are listed in dirty_cells. If anything has been drawn
+ *	directly into zdk_screen, full_scan is set and show_screen compares
+ *	every cell instead.
+ */
+typedef struct Layer {
+    Screen * screen;
+    int * cells;
+    char * listed;
+    int count;
+} Layer;
+
+static Layer layers[NUM_LAYERS];
+static int active_layer = LAYER_NONE;
+static int blank_colour = 0;
+
+static int * dirty_cells = NULL;
+static char * dirty_mark = NULL;
+static int dirty_count = 0;
+static bool full_scan = true;
+
+static int layer_capacity = 0;
+
+/*
+ *	Set by the SIGWINCH handler, and consumed by screen_resized().
+ */
+static volatile sig_atomic_t resize_pending = 0;
+static void (*previous_winch_handler)(int) = SIG_DFL;
+
+static void destroy_layers(void);
+static bool resize_layers(int width, int height);
+
 /*
  * The current foreground and background colour.
  */
@@ -57,6 +100,31 @@ static int background = BLACK;
 static int colour_flags = 0;
 static int colour_num = 0;
 
+/*
+ * Colour pairs are initialised on first use rather than all at once. A pair
+ * requested before curses has started is initialised by setup_screen.
+ */
+#define PAIR_UNUSED      (0)
+#define PAIR_REQUESTED   (1)
+#define PAIR_READY       (2)
+
+static char pair_state[NUM_COLOURS * NUM_COLOURS + 1];
+static bool colours_started = false;
+
+/*
+ * Palette entries, each holding a colour combination and its precomputed
+ * curses attribute.
+ */
+typedef struct PaletteEntry {
+    int foreground;
+    int background;
+    int flags;
+    int attr;
+} PaletteEntry;
+
+static PaletteEntry palette[MAX_PALETTE];
+static int palette_size = 0;
+
 /*
 **	Helper function which gets the colour number corresponding to a designated
 **	(foreground,background) combination.
@@ -76,6 +144,27 @@ static int colour_index(int fg, int bg) {
     return bg * NUM_COLOURS + fg + PAIR_OFFSET;
 }
 
+/*
+**	Helper function which initialises the curses colour pair for a designated
+**	(foreground,background) combination, if that has not already been done.
+*/
+
+static void init_colour_pair(int fg, int bg) {
+    int index = colour_index(fg, bg);
+
+    if (pair_state[index] == PAIR_READY) {
+        return;
+    }
+
+    if (colours_started) {
+        init_pair(index, fg, bg);
+        pair_state[index] = PAIR_READY;
+    }
+    else {
+        pair_state[index] = PAIR_REQUESTED;
+    }
+}
+
 /*
 **	Helper function which gets the ncurses attribute corresponding to the
 **	current (foreground,background) combination.
@@ -88,6 +177,8 @@ static int colour_index(int fg, int bg) {
 */
 
 static void update_colour_num(void) {
+    init_colour_pair(foreground, background);
+
     int pair = COLOR_PAIR(colour_index(foreground, background));
 
     if (colour_flags & BRIGHT) {
@@ -152,20 +243,68 @@ int get_foreground(void) {
     return foreground | colour_flags;
 }
 
+/*
+**	See graphics.h for documentation.
+*/
+int add_palette_colour(int foreground_, int background_) {
+    if (palette_size >= MAX_PALETTE) {
+        return -1;
+    }
+
+    int saved_foreground = foreground;
+    int saved_background = background;
+    int saved_flags = colour_flags;
+
+    set_colours(foreground_, background_);
+
+    PaletteEntry * entry = &palette[palette_size];
+    entry->foreground = foreground;
+    entry->background = background;
+    entry->flags = colour_flags;
+    entry->attr = colour_num;
+
+    foreground = saved_foreground;
+    background = saved_background;
+    colour_flags = saved_flags;
+    update_colour_num();
+
+    return palette_size++;
+}
+
+/*
+**	See graphics.h for documentation.
+*/
+void use_palette_colour(int index) {
+    assert(index >= 0 && index < palette_size);
+
+    PaletteEntry * entry = &palette[index];
+    foreground = entry->foreground;
+    background = entry->background;
+    colour_flags = entry->flags;
+    colour_num = entry->attr;
+}
+
 /*
 **	See graphics.h for documentation.
 */
 void setup_screen(void) {
+    if (zdk_null_render) {
+        zdk_suppress_output = true;
+    }
+
     if (!zdk_suppress_output) {
         // Enter curses mode.
         initscr();
         start_color();
+        colours_started = true;
 
-        // Set up a colour pair for each terminal colour.
-        // The default background colour is black. 
+        // Set up any colour pairs which were requested before curses started.
+        // The rest are set up on first use.
         for (int fg = 0; fg < NUM_COLOURS; fg++) {
             for (int bg = 0; bg < NUM_COLOURS; bg++) {
-                init_pair(colour_index(fg, bg), fg, bg);
+                if (pair_state[colour_index(fg, bg)] == PAIR_REQUESTED) {
+                    init_colour_pair(fg, bg);
+                }
             }
         }
 
@@ -173,6 +312,7 @@ void setup_screen(void) {
         background = COLOR_BLACK;
         update_colour_num();
         bkgd(colour_num);
+        blank_colour = colour_num;
 
         // Do not echo keypresses.
         noecho();
@@ -205,10 +345,72 @@ void setup_screen(void) {
         void ctrl_c_handler(int signal_code);
         signal(SIGINT, ctrl_c_handler);
         atexit(cleanup_screen);
+
+#ifdef SIGWINCH
+        if (!zdk_suppress_output) {
+            void winch_handler(int signal_code);
+            previous_winch_handler = signal(SIGWINCH, winch_handler);
+        }
+#endif
+
         deja_vu = true;
     }
 }
 
+#ifdef SIGWINCH
+/**
+ *	Signal handler for terminal resize. Records that a resize is pending
+ *	for screen_resized(), then passes the signal on to any handler curses
+ *	had installed so that its own bookkeeping stays correct.
+ */
+void winch_handler(int signal_code) {
+    resize_pending = 1;
+
+    if (previous_winch_handler != SIG_DFL && previous_winch_handler != SIG_IGN && previous_winch_handler != SIG_ERR) {
+        previous_winch_handler(signal_code);
+    }
+}
+#endif
+
+/*
+**	See graphics.h for documentation.
+*/
+bool screen_resized(void) {
+    if (!resize_pending || zdk_screen == NULL) {
+        return false;
+    }
+
+    resize_pending = 0;
+
+    int old_width = zdk_screen->width;
+    int old_height = zdk_screen->height;
+
+    if (!zdk_suppress_output) {
+#ifdef TIOCGWINSZ
+        struct winsize size;
+
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0 && size.ws_row > 0) {
+            resize_term(size.ws_row, size.ws_col);
+        }
+#endif
+    }
+
+    fit_screen_to_window();
+
+    if (zdk_screen->width == old_width && zdk_screen->height == old_height) {
+        return false;
+    }
+
+    if (!zdk_suppress_output) {
+        // The terminal contents no longer match the back buffer, so wipe
+        // both and let the next show_screen repaint every cell.
+        clear();
+        memset(zdk_prev_screen->pixels[0], 0, zdk_prev_screen->width * zdk_prev_screen->height);
+    }
+
+    return true;
+}
+
 /**
  *	Signal handler for ctrl-c to ensure screen is cleaned up properly.
  */
@@ -234,6 +436,8 @@ void cleanup_screen(void) {
     destroy_screen(zdk_prev_screen);
     zdk_prev_screen = NULL;
 
+    destroy_layers();
+
     // Close the screen-cast file, if open.
     if (zdk_save_stream) {
         fflush(zdk_save_stream);
@@ -251,11 +455,14 @@ void cleanup_screen(void) {
 **	See graphics.h for documentation.
 */
 void clear_screen(void) {
+    if (zdk_null_render) return;
+
     if (zdk_screen != NULL) {
         int w = zdk_screen->width;
         int h = zdk_screen->height;
 
         set_foreground(WHITE);
+        blank_colour = colour_num;
 
         char * scr = zdk_screen->pixels[0];
         int * colours = zdk_screen->colours[0];
@@ -265,6 +472,8 @@ void clear_screen(void) {
         for (int i = 0; i < w*h; i++) {
             colours[i] = colour_num;
         }
+
+        full_scan = true;
     }
 }
 
@@ -272,6 +481,8 @@ void clear_screen(void) {
 **	See graphics.h for documentation.
 */
 void show_screen(void) {
+    if (zdk_null_render) return;
+
     // Draw parts of the display that are different in the front
     // buffer from the back buffer.
     char ** back_px = zdk_prev_screen->pixels;
@@ -282,17 +493,35 @@ void show_screen(void) {
     int h = zdk_screen->height;
     bool changed = false;
 
-    // Check each character to see if it has changed (either in value or colour)
-    // since the last time the function was called.
-    for (int y = 0; y < h; y++) {
-        for (int x = 0; x < w; x++) {
+    if (full_scan) {
+        // Check each character to see if it has changed (either in value or colour)
+        // since the last time the function was called.
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                if (front_px[y][x] != back_px[y][x] || front_colour[y][x] != back_colour[y][x]) {
+                    // Send changed char data to terminal.
+                    attrset(front_colour[y][x]);
+                    // color_set(COLOR_PAIR(front_colour[y][x]), NULL);
+                    mvaddch(y, x, front_px[y][x]);
+
+                    // Save new char data in back buffer.
+                    back_px[y][x] = front_px[y][x];
+                    back_colour[y][x] = front_colour[y][x];
+                    changed = true;
+                }
+            }
+        }
+    }
+    else {
+        // Only cells recomposited from the layers can have changed.
+        for (int i = 0; i < dirty_count; i++) {
+            int x = dirty_cells[i] % w;
+            int y = dirty_cells[i] / w;
+
             if (front_px[y][x] != back_px[y][x] || front_colour[y][x] != back_colour[y][x]) {
-                // Send changed char data to terminal.
                 attrset(front_colour[y][x]);
-                // color_set(COLOR_PAIR(front_colour[y][x]), NULL);
                 mvaddch(y, x, front_px[y][x]);
 
-                // Save new char data in back buffer.
                 back_px[y][x] = front_px[y][x];
                 back_colour[y][x] = front_colour[y][x];
                 changed = true;
@@ -300,6 +529,13 @@ void show_screen(void) {
         }
     }
 
+    for (int i = 0; i < dirty_count; i++) {
+        dirty_mark[dirty_cells[i]] = 0;
+    }
+
+    dirty_count = 0;
+    full_scan = false;
+
     if (!changed) {
         return;
     }
@@ -317,13 +553,22 @@ void show_screen(void) {
 **	See graphics.h for documentation.
 */
 void draw_char(int x, int y, char value) {
+    if (zdk_null_render) return;
+
     if (zdk_screen != NULL) {
         int w = zdk_screen->width;
         int h = zdk_screen->height;
 
         if (x >= 0 && x < w && y >= 0 && y < h) {
-            zdk_screen->pixels[y][x] = value;
-            zdk_screen->colours[y][x] = colour_num;
+            if (active_layer == LAYER_NONE) {
+                zdk_screen->pixels[y][x] = value;
+                zdk_screen->colours[y][x] = colour_num;
+                full_scan = true;
+            }
+            else {
+                void draw_layer_char(int x, int y, char value);
+                draw_layer_char(x, y, value);
+            }
         }
     }
 }
@@ -331,14 +576,14 @@ void draw_char(int x, int y, char value) {
 /*
 **	See graphics.h for documentation.
 */
-void draw_line(int x1, int y1, int x2, int y2, char value) {
+void trace_line(int x1, int y1, int x2, int y2, void (*plot)(int x, int y, void * data), void * data) {
     if (x1 == x2) {
         // Draw vertical line
         int y_min = MIN(y1, y2);
         int y_max = MAX(y1, y2);
 
         for (int i = y_min; i <= y_max; i++) {
-            draw_char(x1, i, value);
+            plot(x1, i, data);
         }
     }
     else if (y1 == y2) {
@@ -347,7 +592,7 @@ void draw_line(int x1, int y1, int x2, int y2, char value) {
         int x_max = MAX(x1, x2);
 
         for (int i = x_min; i <= x_max; i++) {
-            draw_char(i, y1, value);
+            plot(i, y1, data);
         }
     }
     else {
@@ -371,10 +616,10 @@ void draw_line(int x1, int y1, int x2, int y2, char value) {
         float derr = ABS(dy / dx);
 
         for (int x = x1, y = y1; (dx > 0) ? x <= x2 : x >= x2; (dx > 0) ? x++ : x--) {
-            draw_char(x, y, value);
+            plot(x, y, data);
             err += derr;
             while (err >= 0.5 && ((dy > 0) ? y <= y2 : y >= y2)) {
-                draw_char(x, y, value);
+                plot(x, y, data);
                 y += (dy > 0) - (dy < 0);
 
                 err -= 1.0;
@@ -383,6 +628,22 @@ void draw_line(int x1, int y1, int x2, int y2, char value) {
     }
 }
 
+/*
+ *	Plots a single character of a line drawn by draw_line.
+ */
+static void plot_char(int x, int y, void * data) {
+    draw_char(x, y, *(char *)data);
+}
+
+/*
+**	See graphics.h for documentation.
+*/
+void draw_line(int x1, int y1, int x2, int y2, char value) {
+    if (zdk_null_render) return;
+
+    trace_line(x1, y1, x2, y2, plot_char, &value);
+}
+
 /*
 **	See graphics.h for documentation.
 */
@@ -398,10 +659,141 @@ char scrape_char(int x, int y) {
     }
 }
 
+/*
+ *	Recomposites a single cell of zdk_screen from the layers, and records
+ *	it for the next call to show_screen if its appearance has changed.
+ */
+static void composite_cell(int x, int y) {
+    char value = ' ';
+    int colour = blank_colour;
+
+    for (int i = NUM_LAYERS - 1; i >= 0; i--) {
+        char layer_value = layers[i].screen->pixels[y][x];
+
+        if (layer_value) {
+            value = layer_value;
+            colour = layers[i].screen->colours[y][x];
+            break;
+        }
+    }
+
+    if (zdk_screen->pixels[y][x] == value && zdk_screen->colours[y][x] == colour) {
+        return;
+    }
+
+    zdk_screen->pixels[y][x] = value;
+    zdk_screen->colours[y][x] = colour;
+
+    int cell = y * zdk_screen->width + x;
+
+    if (!dirty_mark[cell]) {
+        dirty_mark[cell] = 1;
+        dirty_cells[dirty_count++] = cell;
+    }
+}
+
+/*
+ *	Writes a character into the active layer. The caller has already
+ *	checked that (x,y) lies on the screen.
+ */
+void draw_layer_char(int x, int y, char value) {
+    Layer * layer = &layers[active_layer];
+    Screen * scr = layer->screen;
+
+    if (scr->pixels[y][x] == value && scr->colours[y][x] == colour_num) {
+        return;
+    }
+
+    scr->pixels[y][x] = value;
+    scr->colours[y][x] = colour_num;
+
+    int cell = y * scr->width + x;
+
+    if (value && !layer->listed[cell]) {
+        layer->listed[cell] = 1;
+        layer->cells[layer->count++] = cell;
+    }
+
+    composite_cell(x, y);
+}
+
+/*
+**	See graphics.h for documentation.
+*/
+void set_layer(int layer) {
+    assert(layer >= LAYER_NONE && layer < NUM_LAYERS);
+
+    if (zdk_null_render) return;
+
+    if (layer != LAYER_NONE && layers[0].screen == NULL && zdk_screen != NULL) {
+        if (!resize_layers(zdk_screen->width, zdk_screen->height)) {
+            layer = LAYER_NONE;
+        }
+    }
+
+    active_layer = layer;
+}
+
+/*
+**	See graphics.h for documentation.
+*/
+int get_layer(void) {
+    return active_layer;
+}
+
+/*
+**	See graphics.h for documentation.
+*/
+void clear_layer(int layer) {
+    assert(layer >= 0 && layer < NUM_LAYERS);
+
+    if (zdk_null_render) return;
+
+    Layer * l = &layers[layer];
+
+    if (l->screen == NULL) {
+        return;
+    }
+
+    int w = l->screen->width;
+
+    for (int i = 0; i < l->count; i++) {
+        int cell = l->cells[i];
+        int x = cell % w;
+        int y = cell / w;
+
+        l->listed[cell] = 0;
+
+        if (l->screen->pixels[y][x]) {
+            l->screen->pixels[y][x] = 0;
+            composite_cell(x, y);
+        }
+    }
+
+    l->count = 0;
+}
+
+/*
+**	See graphics.h for documentation.
+*/
+void composite_layers(void) {
+    if (zdk_null_render || zdk_screen == NULL || layers[0].screen == NULL) {
+        return;
+    }
+
+    for (int y = 0; y < zdk_screen->height; y++) {
+        for (int x = 0; x < zdk_screen->width; x++) {
+            composite_cell(x, y);
+        }
+    }
+}
+
 /*
 **	See graphics.h for documentation.
 */
 void draw_solid_line(int x1, int y1, int x2, int y2, int colour) {
+    if (zdk_null_render) return;
+
     int fg = get_foreground();
     int bg = get_background();
     set_foreground(colour | INVERSE);
@@ -415,6 +807,8 @@ void draw_solid_line(int x1, int y1, int x2, int y2, int colour) {
 **	See graphics.h for documentation.
 */
 void draw_string(int x, int y, char * text) {
+    if (zdk_null_render) return;
+
     for (int i = 0; text[i]; i++) {
         draw_char(x + i, y, text[i]);
     }
@@ -424,6 +818,8 @@ void draw_string(int x, int y, char * text) {
 **	See graphics.h for documentation.
 */
 void draw_int(int x, int y, int value) {
+    if (zdk_null_render) return;
+
     char buffer[100];
     snprintf(buffer, sizeof(buffer), "%d", value);
     draw_string(x, y, buffer);
@@ -433,6 +829,8 @@ void draw_int(int x, int y, int value) {
 **	See graphics.h for documentation.
 */
 void draw_double(int x, int y, double value) {
+    if (zdk_null_render) return;
+
     char buffer[100];
     snprintf(buffer, sizeof(buffer), "%g", value);
     draw_string(x, y, buffer);
@@ -442,6 +840,8 @@ void draw_double(int x, int y, double value) {
 **	See graphics.h for documentation.
 */
 void draw_formatted(int x, int y, const char * format, ...) {
+    if (zdk_null_render) return;
+
     va_list args;
     va_start(args, format);
     char buffer[1000];
@@ -460,12 +860,19 @@ int get_char() {
     if (zdk_input_stream) {
         current_char = fgetc(zdk_input_stream);
     }
+    else if (zdk_null_render) {
+        current_char = ERR;
+    }
     else {
         current_char = getch();
     }
 
     save_char(current_char);
 
+    if (current_char == KEY_RESIZE) {
+        resize_pending = 1;
+    }
+
     if (current_char == KEY_MOUSE) {
         memset(&mouse_event, 0, sizeof(mouse_event));
         getmouse(&mouse_event);
@@ -504,6 +911,9 @@ int wait_char() {
     if (zdk_input_stream) {
         current_char = fgetc(zdk_input_stream);
     }
+    else if (zdk_null_render) {
+        current_char = ERR;
+    }
     else {
         timeout(-1);
         current_char = getch();
@@ -512,6 +922,10 @@ int wait_char() {
 
     save_char(current_char);
 
+    if (current_char == KEY_RESIZE) {
+        resize_pending = 1;
+    }
+
     if (current_char == KEY_MOUSE) {
         memset(&mouse_event, 0, sizeof(mouse_event));
         getmouse(&mouse_event);
@@ -520,6 +934,60 @@ int wait_char() {
     return current_char;
 }
 
+/*
+**	See graphics.h for documentation.
+*/
+int wait_char_until(int64_t deadline_ns) {
+    if (zdk_input_stream) {
+        return get_char();
+    }
+
+    if (zdk_null_render) {
+        /* No input can arrive to end an indefinite wait, so report none at once. */
+        if (deadline_ns == INT64_MAX) {
+            return get_char();
+        }
+
+        timer_pause_until(deadline_ns);
+        return get_char();
+    }
+
+    while (true) {
+        /* Curses may already hold input which poll() cannot see. */
+        int current_char = get_char();
+
+        if (current_char != ERR || resize_pending) {
+            return current_char;
+        }
+
+        int64_t remaining = deadline_ns - get_monotonic_ns();
+
+        if (remaining <= 0) {
+            return ERR;
+        }
+
+        int64_t nanoseconds_per_millisecond = NANOSECONDS / MILLISECONDS;
+
+        if (remaining < nanoseconds_per_millisecond) {
+            /* Too short for poll() to time, so sleep out the rest. */
+            timer_pause_until(deadline_ns);
+            continue;
+        }
+
+        int timeout_ms = remaining / nanoseconds_per_millisecond > INT_MAX
+            ? -1
+            : (int)(remaining / nanoseconds_per_millisecond);
+
+        struct pollfd input = { .fd = STDIN_FILENO, .events = POLLIN };
+
+        /* A signal such as SIGWINCH interrupts the wait, and the next pass
+        ** around the loop reports the pending resize to the caller. */
+        if (poll(&input, 1, timeout_ms) < 0 && errno != EINTR) {
+            timer_pause_until(deadline_ns);
+        }
+    }
+}
+
 /*
 **	See graphics.h for documentation.
 */
@@ -597,13 +1065,33 @@ void override_screen_size(int width, int height) {
 
     update_buffer(&zdk_screen, width, height, ' ', colour_num);
     update_buffer(&zdk_prev_screen, width, height, ' ', colour_num);
+
+    // Layer contents are laid out for the old dimensions, so start afresh.
+    if (layers[0].screen != NULL) {
+        if (resize_layers(width, height)) {
+            composite_layers();
+        }
+        else {
+            active_layer = LAYER_NONE;
+        }
+    }
+
+    full_scan = true;
 }
 
-// Private helper function to allocate sccreen buffer.
-static void ** allocate_screen_buffer(int width, int height, char data, size_t element_size);
+// Private helper functions to allocate and reshape sccreen buffers.
+static void ** allocate_screen_buffer(int width, int height, int capacity, int row_capacity, char data, size_t element_size);
+static void reflow_screen_buffer(void ** buffer, int old_width, int old_height, int width, int height, char default_value, size_t element_size);
 
 /**
- *	Private helper function which reallocates and clears the designated buffer.
+ *	Private helper function which resizes the designated buffer, preserving
+ *	the content which lies in the area common to the old and new sizes.
+ *
+ *	If the existing allocation is large enough, the buffer is reshaped in
+ *	place. Otherwise, the capacity is at least doubled so that a sequence of
+ *	resizes (e.g. while the user drags the edge of the terminal window)
+ *	causes only a logarithmic number of allocations.
+ *
  *	PRE:	buffer &ne; NULL
  *		AND	width &gt; 0
  *		AND height &gt; 0.
@@ -623,6 +1111,22 @@ void update_buffer(Screen ** screen, int width, int height, char character, char
         return;
     }
 
+    if (old_screen != NULL && width * height <= old_screen->capacity && height <= old_screen->row_capacity) {
+        reflow_screen_buffer((void **)old_screen->pixels, old_screen->width, old_screen->height, width, height, character, sizeof(char));
+        reflow_screen_buffer((void **)old_screen->colours, old_screen->width, old_screen->height, width, height, colour_num, sizeof(int));
+        old_screen->width = width;
+        old_screen->height = height;
+        return;
+    }
+
+    int capacity = width * height;
+    int row_capacity = height;
+
+    if (old_screen != NULL) {
+        capacity = MAX(capacity, 2 * old_screen->capacity);
+        row_capacity = MAX(row_capacity, 2 * old_screen->row_capacity);
+    }
+
     Screen * new_screen = calloc(1, sizeof(Screen));
 
     if (!new_screen) {
@@ -632,15 +1136,17 @@ void update_buffer(Screen ** screen, int width, int height, char character, char
 
     new_screen->width = width;
     new_screen->height = height;
+    new_screen->capacity = capacity;
+    new_screen->row_capacity = row_capacity;
 
-    new_screen->pixels = (char**)allocate_screen_buffer(width, height, character, sizeof(char));
+    new_screen->pixels = (char**)allocate_screen_buffer(width, height, capacity, row_capacity, character, sizeof(char));
 
     if (!new_screen->pixels) {
         destroy_screen(new_screen);
         return;
     }
 
-    new_screen->colours = (int**)allocate_screen_buffer(width, height, colour_num, sizeof(int));
+    new_screen->colours = (int**)allocate_screen_buffer(width, height, capacity, row_capacity, colour_num, sizeof(int));
 
     if (!new_screen->colours) {
         destroy_screen(new_screen);
@@ -664,6 +1170,12 @@ void update_buffer(Screen ** screen, int width, int height, char character, char
 **	Input:
 **		width, height: the number of columns and rows respectively in the table.
 **
+**		capacity: the number of elements to allocate, which must be at least
+**			width * height. The surplus allows the table to grow in place.
+**
+**		row_capacity: the number of row pointers to allocate, which must be
+**			at least height.
+**
 **		default_value: a char code which will be used to initialise all cells
 **			in the table.
 **
@@ -672,14 +1184,14 @@ void update_buffer(Screen ** screen, int width, int height, char character, char
 **	Output:
 **		Returns the address of the 2D aray structure.
 */
-static void ** allocate_screen_buffer(int width, int height, char default_value, size_t element_size) {
-    void ** buffer = calloc(height, sizeof(void *));
+static void ** allocate_screen_buffer(int width, int height, int capacity, int row_capacity, char default_value, size_t element_size) {
+    void ** buffer = calloc(row_capacity, sizeof(void *));
 
     if (!buffer) {
         return NULL;
     }
 
-    buffer[0] = calloc(width * height, element_size);
+    buffer[0] = calloc(capacity, element_size);
 
     if (!buffer[0]) {
         free(buffer);
@@ -694,6 +1206,44 @@ static void ** allocate_screen_buffer(int width, int height, char default_value,
     return buffer;
 }
 
+/*
+**	Reshapes a table created by allocate_screen_buffer to new dimensions
+**	without reallocating it. Content in the area common to both sizes keeps
+**	its (x,y) position; cells outside that area are set to default_value.
+**
+**	PRE:	width * height does not exceed the capacity of the table
+**		AND height does not exceed its row capacity.
+*/
+static void reflow_screen_buffer(void ** buffer, int old_width, int old_height, int width, int height, char default_value, size_t element_size) {
+    char * base = buffer[0];
+    int clip_width = MIN(old_width, width);
+    int clip_height = MIN(old_height, height);
+    size_t old_stride = old_width * element_size;
+    size_t new_stride = width * element_size;
+
+    if (width > old_width) {
+        // Rows move towards the end of the block, so work from the bottom up.
+        for (int y = clip_height - 1; y >= 0; y--) {
+            memmove(base + y * new_stride, base + y * old_stride, clip_width * element_size);
+            memset(base + y * new_stride + clip_width * element_size, default_value, (width - clip_width) * element_size);
+        }
+    }
+    else if (width < old_width) {
+        // Rows move towards the start of the block, so work from the top down.
+        for (int y = 1; y < clip_height; y++) {
+            memmove(base + y * new_stride, base + y * old_stride, clip_width * element_size);
+        }
+    }
+
+    if (height > clip_height) {
+        memset(base + clip_height * new_stride, default_value, (height - clip_height) * new_stride);
+    }
+
+    for (int y = 1; y < height; y++) {
+        buffer[y] = base + y * new_stride;
+    }
+}
+
 /**
  *	Copies the data from one screen into the bitmap of another,
  *	clipping to ensure that data is only copied in the smallest
@@ -773,6 +1323,89 @@ void destroy_screen(Screen * scr) {
     }
 }
 
+/**
+ *	Resizes the layers and the dirty-cell list to match a screen of the
+ *	designated size, and erases every layer. Memory is reused where
+ *	possible, and grown geometrically otherwise.
+ *
+ *	Output:
+ *		Returns true if and only if all allocations succeeded. On failure,
+ *		no layers remain allocated.
+ */
+static bool resize_layers(int width, int height) {
+    int cells = width * height;
+
+    if (cells > layer_capacity) {
+        int capacity = MAX(cells, 2 * layer_capacity);
+
+        int * new_dirty_cells = realloc(dirty_cells, capacity * sizeof(int));
+        if (new_dirty_cells) dirty_cells = new_dirty_cells;
+
+        char * new_dirty_mark = realloc(dirty_mark, capacity);
+        if (new_dirty_mark) dirty_mark = new_dirty_mark;
+
+        bool ok = new_dirty_cells && new_dirty_mark;
+
+        for (int i = 0; i < NUM_LAYERS; i++) {
+            int * new_cells = realloc(layers[i].cells, capacity * sizeof(int));
+            if (new_cells) layers[i].cells = new_cells;
+
+            char * new_listed = realloc(layers[i].listed, capacity);
+            if (new_listed) layers[i].listed = new_listed;
+
+            ok = ok && new_cells && new_listed;
+        }
+
+        if (!ok) {
+            destroy_layers();
+            return false;
+        }
+
+        layer_capacity = capacity;
+    }
+
+    void update_buffer(Screen ** buffer, int width, int height, char character, char colour_num);
+
+    memset(dirty_mark, 0, layer_capacity);
+    dirty_count = 0;
+
+    for (int i = 0; i < NUM_LAYERS; i++) {
+        Layer * l = &layers[i];
+
+        update_buffer(&l->screen, width, height, 0, 0);
+
+        if (!l->screen || l->screen->width != width || l->screen->height != height) {
+            destroy_layers();
+            return false;
+        }
+
+        memset(l->screen->pixels[0], 0, cells);
+        memset(l->listed, 0, layer_capacity);
+        l->count = 0;
+    }
+
+    return true;
+}
+
+/**
+ *	Releases all memory allocated to the layers and the dirty-cell list.
+ */
+static void destroy_layers(void) {
+    for (int i = 0; i < NUM_LAYERS; i++) {
+        destroy_screen(layers[i].screen);
+        free(layers[i].cells);
+        free(layers[i].listed);
+        memset(&layers[i], 0, sizeof(Layer));
+    }
+
+    free(dirty_cells);
+    free(dirty_mark);
+    dirty_cells = NULL;
+    dirty_mark = NULL;
+    dirty_count = 0;
+    layer_capacity = 0;
+}
+
 void auto_save_screen(bool save_if_true) {
     if (save_if_true && !zdk_save_stream) {
         char file_name[100];
@@ -45,12 +45,21 @@
  *              colour data of the display. To access the colour at
  *              location (x,y) of Screen * s, use:
  *                               s->colours[y][x]
+ *
+ *      capacity - The number of cells allocated for pixels and colours, which
+ *              may exceed width * height. A resize that fits within the
+ *              capacity reuses the existing memory.
+ *
+ *      row_capacity - The number of row pointers allocated for pixels and
+ *              colours, which may exceed height.
  */
 typedef struct Screen {
     int width;
     int height;
     char ** pixels;
     int ** colours;
+    int capacity;
+    int row_capacity;
 } Screen;
 
 /**
@@ -58,13 +67,13 @@ typedef struct Screen {
  *    The contents of this screen will be rendered into the display
  *    when show_screen() is called.
  */
-Screen * zdk_screen;
+extern Screen * zdk_screen;
 
 /**
  *    A backing screen which contains a copy data previously displayed by
  *    show_screen().
  */
-Screen * zdk_prev_screen;
+extern Screen * zdk_prev_screen;
 
 /**
  *    Set up the terminal display for curses-based graphics:
@@ -235,6 +244,28 @@ void draw_formatted(int x, int y, const char * format, ...);
  */
 void draw_line(int x1, int y1, int x2, int y2, char value);
 
+/**
+ *    Visits each cell of the line segment from (x1,y1) to (x2,y2), in the
+ *    same order and with the same rasterisation as draw_line(), without
+ *    drawing anything.
+ *
+ *    Input:
+ *        (x1,y1), (x2,y2) - The endpoints of the line, as for draw_line().
+ *
+ *        plot - A function which is called with the coordinates of each cell
+ *               in turn. Coordinates are not clipped to the screen. A cell
+ *               may be visited more than once.
+ *
+ *        data - An arbitrary pointer which is passed through to plot.
+ *
+ *    Output: void.
+ *
+ *    Notes: This allows an application to build its own map of the cells a
+ *        line covers (for example, a collision grid) which agrees exactly
+ *        with what draw_line() would display.
+ */
+void trace_line(int x1, int y1, int x2, int y2, void (*plot)(int x, int y, void * data), void * data);
+
 /*
 **    Draws the specified symbol at the prescribed (x,y) location in the terminal
 **    window. The rendered character is added to the zdk_screen buffer, but
@@ -341,6 +372,33 @@ int screen_height(void);
  */
 int wait_char(void);
 
+/**
+ *    Waits until either a character arrives on the standard input stream or
+ *    the monotonic clock (see get_monotonic_ns) reaches a designated deadline,
+ *    whichever comes first, without consuming processor time while waiting.
+ *
+ *    Use this in place of a get_char() / timer_pause() pair in a game loop:
+ *    keys are handled the moment they are pressed rather than at the next
+ *    tick, and nothing wakes the program while there is neither input nor
+ *    work to do.
+ *
+ *    Input:
+ *        deadline_ns: The monotonic time, in nanoseconds, at which to give up
+ *                     waiting. INT64_MAX waits for input indefinitely.
+ *
+ *    Output: The next character, as for get_char(), or ERR if the deadline
+ *            passed first. ERR is also returned early if the terminal window
+ *            is resized while waiting, so the caller can respond via
+ *            screen_resized().
+ *
+ *    Notes:    (Advanced) If the zdk_input_stream is non-null, the next
+ *            character is read from that stream immediately, without waiting.
+ *            If zdk_null_render is set, no input can arrive: the call sleeps
+ *            until the deadline and returns ERR, or returns ERR at once for a
+ *            deadline of INT64_MAX rather than sleeping forever.
+ */
+int wait_char_until(int64_t deadline_ns);
+
 /**
  *    Immediately returns the next character from the standard input stream
  *    if one is available, or ERR if none is present.
@@ -470,9 +528,36 @@ void override_screen_size(int width, int height);
  *        width or height has changed, _then_ invoke this function. You will
  *        probably have to recalculate the entire view to ensure objects are not
  *        lost outside the visible display area.
+ *
+ *        Resizing the screen erases all layers (see set_layer), so layered
+ *        content must be redrawn afterwards.
+ *
+ *        Buffers are reshaped in place when the new size fits within their
+ *        capacity, and otherwise grow geometrically, so repeated resizes do
+ *        not cause an allocation each time.
  */
 void fit_screen_to_window(void);
 
+/**
+ *    Checks whether the terminal window has been resized since the last call
+ *    and, if so, resizes the curses display and the zdk_screen and
+ *    zdk_prev_screen buffers to match.
+ *
+ *    Input: void.
+ *
+ *    Output: Returns true if and only if the dimensions of the screen buffers
+ *            have changed. The caller should then recalculate its view.
+ *
+ *    Notes:
+ *    .    Resizes are detected by a SIGWINCH handler installed by
+ *        setup_screen(), and also when get_char() or wait_char() returns
+ *        KEY_RESIZE. The handler only records that a resize is pending; all
+ *        of the work is done here, outside signal context.
+ *    .    After a resize, the whole display is repainted by the next call to
+ *        show_screen().
+ */
+bool screen_resized(void);
+
 /*
 **    A list of known colours.
 */
@@ -614,6 +699,43 @@ void set_colours(int foreground, int background);
 */
 void get_colours(int *foreground, int *background);
 
+/*
+**    The maximum number of entries in the colour palette.
+*/
+#define MAX_PALETTE (32)
+
+/*
+**    Adds a colour combination to the palette. The curses attribute for the
+**    combination is computed once, here, so that selecting it later with
+**    use_palette_colour() costs no more than a few assignments.
+**
+**    Input:
+**        foreground - the colour index for text foreground. This may be OR'd with
+**            BRIGHT, INVERSE, or TRANSPARENT modifiers if desired.
+**
+**        background - the colour for the text background.
+**
+**    Returns:
+**        The index of the new palette entry, or -1 if the palette is full.
+**
+**    Side effects:
+**        None. The current drawing colours are unchanged.
+*/
+int add_palette_colour(int foreground, int background);
+
+/*
+**    Selects a palette entry as the colour for subsequent drawing operations.
+**    This has the same effect as calling set_colours() with the values that
+**    were passed to add_palette_colour(), but without recomputing anything.
+**
+**    Input:
+**        index - A value previously returned by add_palette_colour().
+**
+**    Returns:
+**        void.
+*/
+void use_palette_colour(int index);
+
 /*
 **    Retrieves a character value out of the most recently displayed screen buffer.
 **
@@ -635,6 +757,80 @@ void get_colours(int *foreground, int *background);
 */
 char scrape_char(int x, int y);
 
+// ------------------------------------------------------------------
+//    Layered rendering.
+// ------------------------------------------------------------------
+
+/*
+**    Layer identifiers, listed from bottom to top. When a layer other than
+**    LAYER_NONE is selected with set_layer(), drawing operations write into
+**    that layer rather than directly into zdk_screen. Each cell of zdk_screen
+**    then shows the top-most layer which has a visible character at that
+**    position, or a blank if no layer does.
+**
+**    LAYER_NONE is the default, and gives the classic behaviour where
+**    drawing operations write straight into zdk_screen.
+*/
+#define LAYER_NONE      (-1)
+#define LAYER_STATIC    (0)
+#define LAYER_HUD       (1)
+#define LAYER_ENTITIES  (2)
+#define LAYER_OVERLAY   (3)
+
+#define NUM_LAYERS      (4)
+
+/*
+**    Selects the layer which will receive subsequent drawing operations.
+**
+**    Input:
+**        layer - LAYER_NONE, or a layer between 0 and (NUM_LAYERS-1), inclusive.
+**
+**    Output:
+**        void.
+**
+**    Notes:
+**    .    Writing to a layer immediately recomposites the affected cell of
+**        zdk_screen, and records the cell so that the next call to
+**        show_screen() only examines cells which may have changed. A frame
+**        in which a single character moves costs two cell updates, rather
+**        than a scan of the whole screen.
+**    .    Drawing the character '\0' into a layer makes that cell transparent.
+**    .    Drawing directly into zdk_screen (LAYER_NONE) or calling
+**        clear_screen() causes the next show_screen() to fall back to
+**        comparing every cell. Avoid mixing the two styles in a single frame.
+*/
+void set_layer(int layer);
+
+/*
+**    Gets the layer which currently receives drawing operations.
+**
+**    Output:
+**        LAYER_NONE, or a value between 0 and (NUM_LAYERS-1), inclusive.
+*/
+int get_layer(void);
+
+/*
+**    Erases the contents of a layer, making every cell transparent. Cells
+**    of zdk_screen that were covered by the layer are recomposited from the
+**    layers beneath.
+**
+**    Input:
+**        layer - A layer between 0 and (NUM_LAYERS-1), inclusive.
+**
+**    Notes:
+**        The cost of this operation is proportional to the number of cells
+**        that have been drawn into the layer since it was last cleared, not
+**        to the size of the screen.
+*/
+void clear_layer(int layer);
+
+/*
+**    Rebuilds every cell of zdk_screen from the layers. Use this after the
+**    screen has been drawn directly (for example, after clear_screen()) to
+**    bring the layered view back into the display.
+*/
+void composite_layers(void);
+
 // ------------------------------------------------------------------
 //    Advanced facilities to support automated testing.
 // ------------------------------------------------------------------
@@ -653,7 +849,7 @@ char scrape_char(int x, int y);
  *    (2)    If you specify an exotic stream such as a memory stream you will
  *        probably have to disable curses functionality.
  */
-FILE * zdk_save_stream;
+extern FILE * zdk_save_stream;
 
 /**
  *    Override standard input stream.
@@ -665,7 +861,7 @@ FILE * zdk_save_stream;
  *    redirection to pipe input from a text file. You may find it
  *    easier to use that rather than attempting to work with this interface.
  */
-FILE * zdk_input_stream;
+extern FILE * zdk_input_stream;
 
 /**
  *    Override: disable all curses functionality
@@ -677,7 +873,27 @@ FILE * zdk_input_stream;
  *    before calling setup_screen(), and don't change it back to false
  *    until after calling cleanup_screen() at the end of the program run.
  */
-bool zdk_suppress_output;
+extern bool zdk_suppress_output;
+
+/**
+ *    Override: disable all rendering.
+ *
+ *    A flag which, if true, turns ZDK into a null renderer for headless runs.
+ *    It implies zdk_suppress_output, and in addition every drawing operation
+ *    (clear_screen, show_screen, draw_char, draw_line, draw_string and so on,
+ *    plus the layer functions) returns immediately without touching the
+ *    screen buffers, and get_char/wait_char return ERR unless
+ *    zdk_input_stream is set.
+ *
+ *    The screen buffers still exist so that screen_width() and
+ *    screen_height() report a size (80 x 24, unless overridden with
+ *    override_screen_size), but they stay blank, so scrape_char() is of no
+ *    use. Applications running in this mode must keep their own record of
+ *    what is where, for instance a collision grid built with trace_line().
+ *
+ *    Set it before calling setup_screen().
+ */
+extern bool zdk_null_render;
 
 /**
  *    Disable ncurses and restore the terminal to its normal operational state.
@@ -12,6 +12,7 @@
 #include "cab202_timers.h"
 #include <assert.h>
 #include <stdlib.h>
+#include <math.h>
 
 
 #ifdef WIN32
@@ -20,6 +21,7 @@
 #include <time.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <errno.h>
 #endif
 
 #ifdef __MACH__
@@ -29,10 +31,202 @@
 
 // ---------------------------------------------------------------------------
 
+/*
+**	A timer wheel has TIMER_WHEEL_LEVELS levels of TIMER_WHEEL_SLOTS slots.
+**	Each slot holds a doubly linked list of timers, threaded through the
+**	prev and next fields of the timers themselves. Each timer also records
+**	the slot which holds it, or NULL if it is not scheduled.
+**
+**	A slot in level n covers TIMER_WHEEL_SLOTS ^ n ticks. A timer lives in
+**	the lowest level whose span reaches its expiry tick, in the slot given by
+**	the corresponding bits of the expiry tick. Whenever the low bits of the
+**	current tick wrap around to zero, the slot of the next level which has
+**	just come due is emptied and its timers are inserted again, which moves
+**	each of them down at least one level. Level 0 slots therefore hold only
+**	timers which expire on exactly the tick the slot is visited.
+*/
+
+#define TIMER_WHEEL_MASK ( TIMER_WHEEL_SLOTS - 1 )
+#define TIMER_WHEEL_SPAN ( ( uint64_t )1 << ( TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS ) )
+
+struct timer_wheel {
+	long tick_milliseconds;
+	uint64_t now;
+	int timer_count;
+	timer_id slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+};
+
+// ---------------------------------------------------------------------------
+
+static timer_id * wheel_slot_for( timer_wheel_id wheel, uint64_t expiry_tick ) {
+	uint64_t delta = expiry_tick > wheel->now ? expiry_tick - wheel->now : 0;
+	int level = 0;
+
+	/* Timers further ahead than the wheel can span are parked in the last
+	** slot it can reach, and are placed again when that slot comes due. */
+	if ( delta >= TIMER_WHEEL_SPAN ) {
+		expiry_tick = wheel->now + TIMER_WHEEL_SPAN - 1;
+		delta = TIMER_WHEEL_SPAN - 1;
+	}
+
+	while ( level < TIMER_WHEEL_LEVELS - 1 && delta >= ( uint64_t )1 << ( TIMER_WHEEL_BITS * ( level + 1 ) ) ) {
+		level++;
+	}
+
+	/* Overdue timers (only possible while cascading) go in the current slot,
+	** which is about to be visited. */
+	if ( delta == 0 ) {
+		expiry_tick = wheel->now;
+	}
+
+	return &wheel->slots[level][( expiry_tick >> ( TIMER_WHEEL_BITS * level ) ) & TIMER_WHEEL_MASK];
+}
+
+// ---------------------------------------------------------------------------
+
+static void wheel_insert( timer_wheel_id wheel, timer_id timer ) {
+	timer_id * slot = wheel_slot_for( wheel, timer->expiry_tick );
+
+	timer->slot = slot;
+	timer->prev = NULL;
+	timer->next = *slot;
+
+	if ( *slot ) {
+		( *slot )->prev = timer;
+	}
+
+	*slot = timer;
+}
+
+// ---------------------------------------------------------------------------
+
+static void wheel_cascade( timer_wheel_id wheel, int level, int index ) {
+	timer_id timer = wheel->slots[level][index];
+	wheel->slots[level][index] = NULL;
+
+	while ( timer ) {
+		timer_id next = timer->next;
+		wheel_insert( wheel, timer );
+		timer = next;
+	}
+}
+
+// ---------------------------------------------------------------------------
+
+timer_wheel_id create_timer_wheel( long tick_milliseconds ) {
+	assert( tick_milliseconds > 0 );
+
+	timer_wheel_id wheel = calloc( 1, sizeof( struct timer_wheel ) );
+
+	wheel->tick_milliseconds = tick_milliseconds;
+
+	return wheel;
+}
+
+// ---------------------------------------------------------------------------
+
+void destroy_timer_wheel( timer_wheel_id wheel ) {
+	assert( wheel != NULL );
+	assert( wheel->timer_count == 0 );
+
+	free( wheel );
+}
+
+// ---------------------------------------------------------------------------
+
+timer_id create_wheel_timer( timer_wheel_id wheel, long milliseconds, void( *callback )( void * context ), void * context ) {
+	assert( wheel != NULL );
+	assert( milliseconds > 0 );
+	assert( callback != NULL );
+
+	timer_id timer = calloc( 1, sizeof( cab202_timer_t ) );
+
+	timer->milliseconds = milliseconds;
+	timer->wheel = wheel;
+	timer->period_ticks = ( milliseconds + wheel->tick_milliseconds - 1 ) / wheel->tick_milliseconds;
+	timer->callback = callback;
+	timer->context = context;
+	wheel->timer_count++;
+
+	timer_reset( timer );
+
+	return timer;
+}
+
+// ---------------------------------------------------------------------------
+
+void timer_cancel( timer_id timer ) {
+	assert( timer != NULL );
+	assert( timer->wheel != NULL );
+
+	if ( timer->slot == NULL ) {
+		return;
+	}
+
+	if ( timer->prev ) {
+		timer->prev->next = timer->next;
+	}
+	else {
+		*timer->slot = timer->next;
+	}
+
+	if ( timer->next ) {
+		timer->next->prev = timer->prev;
+	}
+
+	timer->prev = timer->next = NULL;
+	timer->slot = NULL;
+}
+
+// ---------------------------------------------------------------------------
+
+int timer_wheel_advance( timer_wheel_id wheel, long ticks ) {
+	assert( wheel != NULL );
+
+	int fired = 0;
+
+	for ( long i = 0; i < ticks; i++ ) {
+		wheel->now++;
+
+		int index = wheel->now & TIMER_WHEEL_MASK;
+
+		for ( int level = 1; index == 0 && level < TIMER_WHEEL_LEVELS; level++ ) {
+			index = ( wheel->now >> ( TIMER_WHEEL_BITS * level ) ) & TIMER_WHEEL_MASK;
+			wheel_cascade( wheel, level, index );
+		}
+
+		timer_id * slot = &wheel->slots[0][wheel->now & TIMER_WHEEL_MASK];
+
+		/* Take one timer at a time, as each callback may change the slot. */
+		while ( *slot ) {
+			timer_id timer = *slot;
+			timer_cancel( timer );
+
+			timer->expiry_tick = wheel->now + timer->period_ticks;
+			wheel_insert( wheel, timer );
+
+			timer->callback( timer->context );
+			fired++;
+		}
+	}
+
+	return fired;
+}
+
+// ---------------------------------------------------------------------------
+
+uint64_t timer_wheel_ticks( timer_wheel_id wheel ) {
+	assert( wheel != NULL );
+
+	return wheel->now;
+}
+
+// ---------------------------------------------------------------------------
+
 timer_id create_timer( long milliseconds ) {
 	assert( milliseconds > 0 );
 
-	timer_id timer = malloc( sizeof( cab202_timer_t ) );
+	timer_id timer = calloc( 1, sizeof( cab202_timer_t ) );
 
 	timer->milliseconds = milliseconds;
 	timer_reset( timer );
@@ -45,6 +239,11 @@ timer_id create_timer( long milliseconds ) {
 void destroy_timer( timer_id timer ) {
 	assert( timer != NULL );
 
+	if ( timer->wheel ) {
+		timer_cancel( timer );
+		timer->wheel->timer_count--;
+	}
+
 	free( timer );
 }
 
@@ -53,15 +252,23 @@ void destroy_timer( timer_id timer ) {
 void timer_reset( timer_id timer ) {
 	assert( timer != NULL );
 
-	timer->reset_time = get_current_time();
+	if ( timer->wheel ) {
+		timer_cancel( timer );
+		timer->expiry_tick = timer->wheel->now + timer->period_ticks;
+		wheel_insert( timer->wheel, timer );
+	}
+	else {
+		timer->reset_time = ( double )get_monotonic_ns() / NANOSECONDS;
+	}
 }
 
 // ---------------------------------------------------------------------------
 
 bool timer_expired( timer_id timer ) {
 	assert( timer != NULL );
+	assert( timer->wheel == NULL );
 
-	double current_time = get_current_time();
+	double current_time = ( double )get_monotonic_ns() / NANOSECONDS;
 	double time_diff = current_time - timer->reset_time;
 	int expired = time_diff * MILLISECONDS >= timer->milliseconds;
 
@@ -74,6 +281,127 @@ bool timer_expired( timer_id timer ) {
 
 // ---------------------------------------------------------------------------
 
+game_clock_id create_game_clock( void ) {
+	game_clock_id clock = malloc( sizeof( cab202_clock_t ) );
+
+	clock->anchor_real = get_monotonic_ns();
+	clock->anchor_game = 0;
+	clock->scale = 1;
+	clock->paused = false;
+
+	return clock;
+}
+
+// ---------------------------------------------------------------------------
+
+void destroy_game_clock( game_clock_id clock ) {
+	assert( clock != NULL );
+
+	free( clock );
+}
+
+// ---------------------------------------------------------------------------
+
+int64_t game_clock_ns( game_clock_id clock ) {
+	assert( clock != NULL );
+
+	if ( clock->paused ) {
+		return clock->anchor_game;
+	}
+
+	int64_t real_elapsed = get_monotonic_ns() - clock->anchor_real;
+
+	if ( clock->scale == 1 ) {
+		return clock->anchor_game + real_elapsed;
+	}
+
+	return clock->anchor_game + ( int64_t )( real_elapsed * clock->scale );
+}
+
+// ---------------------------------------------------------------------------
+
+/*
+**	Moves the anchor of a game clock to the present, so that the pause state
+**	or scale can be changed without affecting the game time already elapsed.
+*/
+static void game_clock_reanchor( game_clock_id clock ) {
+	clock->anchor_game = game_clock_ns( clock );
+	clock->anchor_real = get_monotonic_ns();
+}
+
+// ---------------------------------------------------------------------------
+
+void game_clock_pause( game_clock_id clock ) {
+	assert( clock != NULL );
+
+	if ( !clock->paused ) {
+		game_clock_reanchor( clock );
+		clock->paused = true;
+	}
+}
+
+// ---------------------------------------------------------------------------
+
+void game_clock_resume( game_clock_id clock ) {
+	assert( clock != NULL );
+
+	if ( clock->paused ) {
+		clock->anchor_real = get_monotonic_ns();
+		clock->paused = false;
+	}
+}
+
+// ---------------------------------------------------------------------------
+
+bool game_clock_paused( game_clock_id clock ) {
+	assert( clock != NULL );
+
+	return clock->paused;
+}
+
+// ---------------------------------------------------------------------------
+
+void game_clock_set_scale( game_clock_id clock, double scale ) {
+	assert( clock != NULL );
+	assert( scale >= 0 );
+
+	game_clock_reanchor( clock );
+	clock->scale = scale;
+}
+
+// ---------------------------------------------------------------------------
+
+double game_clock_scale( game_clock_id clock ) {
+	assert( clock != NULL );
+
+	return clock->scale;
+}
+
+// ---------------------------------------------------------------------------
+
+int64_t game_clock_deadline( game_clock_id clock, int64_t game_ns ) {
+	assert( clock != NULL );
+
+	if ( clock->paused || clock->scale <= 0 ) {
+		return INT64_MAX;
+	}
+
+	int64_t now = get_monotonic_ns();
+	int64_t game_remaining = game_ns - game_clock_ns( clock );
+
+	if ( game_remaining <= 0 ) {
+		return now;
+	}
+
+	if ( clock->scale == 1 ) {
+		return now + game_remaining;
+	}
+
+	return now + ( int64_t )ceil( game_remaining / clock->scale );
+}
+
+// ---------------------------------------------------------------------------
+
 void( *zdk_timer_pause )( long milliseconds ) = NULL;
 
 // ---------------------------------------------------------------------------
@@ -94,6 +422,34 @@ void timer_pause( long milliseconds ) {
 
 // ---------------------------------------------------------------------------
 
+void timer_pause_until( int64_t deadline_ns ) {
+	int64_t remaining = deadline_ns - get_monotonic_ns();
+
+	if ( remaining <= 0 ) {
+		return;
+	}
+
+	if ( zdk_timer_pause || zdk_get_current_time || zdk_get_monotonic_ns ) {
+		/* Round up, so the deadline has passed when the pause ends. */
+		timer_pause( ( remaining + NANOSECONDS / MILLISECONDS - 1 ) / ( NANOSECONDS / MILLISECONDS ) );
+		return;
+	}
+
+#if defined(WIN32) || defined(__MACH__)
+	timer_pause( ( remaining + NANOSECONDS / MILLISECONDS - 1 ) / ( NANOSECONDS / MILLISECONDS ) );
+#else
+	struct timespec deadline;
+	deadline.tv_sec = deadline_ns / NANOSECONDS;
+	deadline.tv_nsec = deadline_ns % NANOSECONDS;
+
+	/* Sleeping to an absolute time means an interrupted sleep can simply resume. */
+	while ( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL ) == EINTR ) {
+	}
+#endif
+}
+
+// ---------------------------------------------------------------------------
+
 double( *zdk_get_current_time )( void ) = NULL;
 
 // ---------------------------------------------------------------------------
@@ -125,6 +481,48 @@ double get_current_time() {
 
 // ---------------------------------------------------------------------------
 
+int64_t( *zdk_get_monotonic_ns )( void ) = NULL;
+
+// ---------------------------------------------------------------------------
+
+int64_t get_monotonic_ns( void ) {
+
+	if ( zdk_get_monotonic_ns ) {
+		return zdk_get_monotonic_ns();
+	}
+	else if ( zdk_get_current_time ) {
+		return ( int64_t )( zdk_get_current_time() * NANOSECONDS );
+	}
+	else {
+#ifdef WIN32
+		static LARGE_INTEGER frequency;
+		LARGE_INTEGER counter;
+
+		if ( frequency.QuadPart == 0 ) {
+			QueryPerformanceFrequency( &frequency );
+		}
+
+		QueryPerformanceCounter( &counter );
+
+		return ( counter.QuadPart / frequency.QuadPart ) * NANOSECONDS
+			+ ( counter.QuadPart % frequency.QuadPart ) * NANOSECONDS / frequency.QuadPart;
+#elif defined(__MACH__)
+		clock_serv_t cclock;
+		mach_timespec_t mts;
+		host_get_clock_service(mach_host_self(), SYSTEM_CLOCK, &cclock);
+		clock_get_time(cclock, &mts);
+		mach_port_deallocate(mach_task_self(), cclock);
+		return ( int64_t )mts.tv_sec * NANOSECONDS + mts.tv_nsec;
+#else
+		struct timespec timeval;
+		clock_gettime( CLOCK_MONOTONIC, &timeval );
+		return ( int64_t )timeval.tv_sec * NANOSECONDS + timeval.tv_nsec;
+#endif
+	}
+}
+
+// ---------------------------------------------------------------------------
+
 bool timers_equal( const cab202_timer_t * a, const cab202_timer_t * b ) {
 	if ( a == b )  return true;
 	if ( a == NULL && b != NULL ) return false;
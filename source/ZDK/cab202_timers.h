@@ -12,19 +12,61 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdint.h>
 
 /*	Constant number of milliseconds in a second. */
 #define MILLISECONDS 1000
 
-/*	Data structure to keep track of elapsed time. */
-typedef struct {
+/*	Constant number of nanoseconds in a second. */
+#define NANOSECONDS 1000000000LL
+
+/*	Number of slots in each level of a timer wheel (see create_timer_wheel),
+ *	and the number of levels. Timers can be scheduled up to
+ *	TIMER_WHEEL_SLOTS ^ TIMER_WHEEL_LEVELS ticks ahead without being
+ *	revisited before they expire. */
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS ( 1 << TIMER_WHEEL_BITS )
+#define TIMER_WHEEL_LEVELS 4
+
+/*	Data type to represent unique timer wheel ID. The layout of a timer
+ *	wheel is private to cab202_timers.c. */
+typedef struct timer_wheel * timer_wheel_id;
+
+/*	Data structure to keep track of elapsed time. The reset time is measured
+ *	in seconds on the monotonic clock (see get_monotonic_ns).
+ *
+ *	The remaining fields are used only by timers which belong to a timer
+ *	wheel (see create_wheel_timer), and should not be accessed directly. */
+typedef struct cab202_timer_t {
 	double reset_time;
 	long milliseconds;
+
+	timer_wheel_id wheel;
+	uint64_t expiry_tick;
+	long period_ticks;
+	void( *callback )( void * context );
+	void * context;
+	struct cab202_timer_t * prev, * next, ** slot;
 } cab202_timer_t;
 
 /*	Data type to represent unique timer ID. */
 typedef cab202_timer_t * timer_id;
 
+/*	Data structure to keep track of game time: a clock which runs at a
+ *	multiple of the rate of the monotonic clock, and which can be stopped
+ *	and started. Game time is measured in nanoseconds, and is anchor_game
+ *	at monotonic time anchor_real. The fields should not be accessed
+ *	directly. */
+typedef struct {
+	int64_t anchor_real;
+	int64_t anchor_game;
+	double scale;
+	bool paused;
+} cab202_clock_t;
+
+/*	Data type to represent unique game clock ID. */
+typedef cab202_clock_t * game_clock_id;
+
 /**
  *	create_timer:
  *
@@ -40,7 +82,9 @@ typedef cab202_timer_t * timer_id;
 timer_id create_timer( long milliseconds );
 
 /**
- *	Deallocates resources associated with the timer.
+ *	Deallocates resources associated with the timer. A timer which belongs
+ *	to a timer wheel is removed from the wheel first, so its callback will
+ *	not be called again.
  *
  *	Input:
  *		timer: the address of a timer to be deallocated.
@@ -50,7 +94,9 @@ void destroy_timer( timer_id timer );
 /*
  *	timer_reset:
  *
- *	Reset a timer to start a new interval.
+ *	Reset a timer to start a new interval. A timer which belongs to a timer
+ *	wheel is rescheduled to expire one full interval after the current tick
+ *	of its wheel, restarting it if it was cancelled.
  *
  *	Input:
  *	-	timer: the address of a timer which is to be reset.
@@ -70,9 +116,232 @@ void timer_reset( timer_id id );
  *
  *	Output:
  *		Returns TRUE if and only if the interval had elapsed.
+ *
+ *	Notes: Timers which belong to a timer wheel report expiry by calling
+ *	their callback instead, and must not be passed to this function.
  */
 bool timer_expired( timer_id timer );
 
+/**
+ *	create_timer_wheel:
+ *
+ *	Creates a timer wheel: a scheduler which calls back a set of timers at
+ *	exact ticks, rather than leaving each timer to be polled with
+ *	timer_expired(). Time on the wheel passes only when the program calls
+ *	timer_wheel_advance(), so a game which stops advancing its wheel while
+ *	paused gets pause-aware timers for free.
+ *
+ *	The wheel is hierarchical: timers due within the next TIMER_WHEEL_SLOTS
+ *	ticks live in the slots of the first level, and timers due later live in
+ *	coarser levels and are moved down a level as their expiry approaches.
+ *	Scheduling, cancelling and firing a timer each take constant time,
+ *	however many timers there are.
+ *
+ *	Input:
+ *	-	tick_milliseconds: the length of one tick of the wheel.
+ *
+ *	Output:
+ *		Returns the address of the new timer wheel, which is at tick 0.
+ */
+timer_wheel_id create_timer_wheel( long tick_milliseconds );
+
+/**
+ *	Deallocates resources associated with a timer wheel. Every timer created
+ *	on the wheel must have been destroyed first.
+ *
+ *	Input:
+ *		wheel: the address of a timer wheel to be deallocated.
+ */
+void destroy_timer_wheel( timer_wheel_id wheel );
+
+/**
+ *	create_wheel_timer:
+ *
+ *	Creates a new repeating timer on a timer wheel and starts it. Every time
+ *	the interval elapses, callback is called with context as its argument,
+ *	and the timer is rescheduled one interval later.
+ *
+ *	The callback may reset, cancel or destroy any timer on the wheel,
+ *	including the one which is being called back.
+ *
+ *	Input:
+ *	-	wheel: the address of the timer wheel which drives the timer.
+ *	-	milliseconds: the length of the interval. It is rounded up to a whole
+ *		number of ticks of the wheel, and is at least one tick long.
+ *	-	callback: the function to call when the interval elapses.
+ *	-	context: an arbitrary value to be passed to callback.
+ *
+ *	Output:
+ *		Returns the address of the timer, which can be reset with
+ *		timer_reset(), cancelled with timer_cancel(), and deallocated with
+ *		destroy_timer().
+ */
+timer_id create_wheel_timer( timer_wheel_id wheel, long milliseconds, void( *callback )( void * context ), void * context );
+
+/**
+ *	timer_cancel:
+ *
+ *	Stops a timer which belongs to a timer wheel, so that its callback is not
+ *	called until it is restarted with timer_reset(). Cancelling a timer which
+ *	is not running has no effect.
+ *
+ *	Input:
+ *	-	timer: the address of a timer on a timer wheel.
+ *
+ *	Output: void.
+ */
+void timer_cancel( timer_id timer );
+
+/**
+ *	timer_wheel_advance:
+ *
+ *	Moves a timer wheel forward by a designated number of ticks, calling back
+ *	every timer which expires on the way, in order of expiry.
+ *
+ *	Input:
+ *	-	wheel: the address of a timer wheel.
+ *	-	ticks: the number of ticks to advance.
+ *
+ *	Output:
+ *		Returns the number of callbacks which were called.
+ */
+int timer_wheel_advance( timer_wheel_id wheel, long ticks );
+
+/**
+ *	timer_wheel_ticks:
+ *
+ *	Gets the number of ticks a timer wheel has advanced since it was created.
+ *
+ *	Input:
+ *	-	wheel: the address of a timer wheel.
+ *
+ *	Output: Returns the current tick of the wheel.
+ */
+uint64_t timer_wheel_ticks( timer_wheel_id wheel );
+
+/**
+ *	create_game_clock:
+ *
+ *	Creates a new game clock, which starts at zero, running at the same rate
+ *	as the monotonic clock (see get_monotonic_ns).
+ *
+ *	Pausing the clock, resuming it or changing its rate costs nothing per
+ *	tick: the clock simply records the game time at which the change was
+ *	made, and computes later readings from there. Anything which is timed
+ *	by the game clock, such as a timer wheel advanced in step with it, is
+ *	paused and scaled along with it.
+ *
+ *	Input: void.
+ *
+ *	Output:
+ *		Returns the address of the new game clock.
+ */
+game_clock_id create_game_clock( void );
+
+/**
+ *	Deallocates resources associated with a game clock.
+ *
+ *	Input:
+ *		clock: the address of a game clock to be deallocated.
+ */
+void destroy_game_clock( game_clock_id clock );
+
+/**
+ *	game_clock_ns:
+ *
+ *	Gets the game time shown by a game clock.
+ *
+ *	Input:
+ *	-	clock: the address of a game clock.
+ *
+ *	Output: Returns the game time, in whole nanoseconds.
+ */
+int64_t game_clock_ns( game_clock_id clock );
+
+/**
+ *	game_clock_pause:
+ *
+ *	Stops a game clock, so that game time does not pass until the clock is
+ *	resumed. Pausing a paused clock has no effect.
+ *
+ *	Input:
+ *	-	clock: the address of a game clock.
+ *
+ *	Output: void.
+ */
+void game_clock_pause( game_clock_id clock );
+
+/**
+ *	game_clock_resume:
+ *
+ *	Restarts a paused game clock from the game time at which it was paused.
+ *	Resuming a running clock has no effect.
+ *
+ *	Input:
+ *	-	clock: the address of a game clock.
+ *
+ *	Output: void.
+ */
+void game_clock_resume( game_clock_id clock );
+
+/**
+ *	game_clock_paused:
+ *
+ *	Determines if a game clock is paused.
+ *
+ *	Input:
+ *	-	clock: the address of a game clock.
+ *
+ *	Output: Returns true if and only if the clock is paused.
+ */
+bool game_clock_paused( game_clock_id clock );
+
+/**
+ *	game_clock_set_scale:
+ *
+ *	Sets the rate at which a game clock runs, relative to the monotonic
+ *	clock. A scale of 0.5 gives slow motion, and a scale of 2 runs the game
+ *	twice as fast. The change applies from the current game time onwards.
+ *
+ *	Input:
+ *	-	clock: the address of a game clock.
+ *	-	scale: the new rate of the clock, which must not be negative.
+ *
+ *	Output: void.
+ */
+void game_clock_set_scale( game_clock_id clock, double scale );
+
+/**
+ *	game_clock_scale:
+ *
+ *	Gets the rate at which a game clock runs, relative to the monotonic clock.
+ *
+ *	Input:
+ *	-	clock: the address of a game clock.
+ *
+ *	Output: Returns the scale set by game_clock_set_scale, or 1.
+ */
+double game_clock_scale( game_clock_id clock );
+
+/**
+ *	game_clock_deadline:
+ *
+ *	Converts a game time into the monotonic time at which a game clock will
+ *	reach it, if the clock keeps running at its current rate. The result
+ *	can be passed to timer_pause_until().
+ *
+ *	Input:
+ *	-	clock: the address of a game clock.
+ *	-	game_ns: a game time, in nanoseconds.
+ *
+ *	Output:
+ *		Returns the monotonic time, in nanoseconds, at which the clock will
+ *		show game_ns. If that time has already passed, the current monotonic
+ *		time is returned. If the clock is paused or its scale is zero, it
+ *		will never get there, and INT64_MAX is returned.
+ */
+int64_t game_clock_deadline( game_clock_id clock, int64_t game_ns );
+
 /**	
  *	timer_pause:
  *
@@ -86,6 +355,28 @@ bool timer_expired( timer_id timer );
  */
 void timer_pause( long milliseconds );
 
+/**
+ *	timer_pause_until:
+ *
+ *	Pauses execution until the monotonic clock (see get_monotonic_ns) reaches
+ *	a designated deadline. Unlike timer_pause(), the length of the pause
+ *	accounts for however long the caller spent working since it chose the
+ *	deadline, so a loop that sleeps until deadline, deadline + step,
+ *	deadline + 2 * step, ... runs at a steady rate without drifting.
+ *
+ *	Input:
+ *		deadline_ns:	The monotonic time, in nanoseconds, at which to resume.
+ *						If it has already passed, the function returns
+ *						immediately.
+ *
+ *	Output: void.
+ *
+ *	Notes: If any of the time overrides (zdk_timer_pause, zdk_get_current_time
+ *	or zdk_get_monotonic_ns) is set, the remaining time is passed to
+ *	timer_pause() instead, so that fake clocks keep working.
+ */
+void timer_pause_until( int64_t deadline_ns );
+
 /**
  *	get_current_time:
  *
@@ -98,6 +389,27 @@ void timer_pause( long milliseconds );
  */
 double get_current_time( void );
 
+/**
+ *	get_monotonic_ns:
+ *
+ *	Gets the time elapsed since an arbitrary fixed point, from a clock which
+ *	never jumps backwards or forwards when the system time is adjusted
+ *	(CLOCK_MONOTONIC on POSIX systems).
+ *
+ *	Use this rather than get_current_time() to measure intervals. The result
+ *	is an exact integer, so intervals can be compared without rounding.
+ *
+ *	Input: void.
+ *
+ *	Output: Returns the current monotonic time in whole nanoseconds.
+ *
+ *	Notes: If zdk_get_monotonic_ns is set, its result is returned instead.
+ *	Otherwise, if zdk_get_current_time is set, its result is converted to
+ *	nanoseconds, so that programs which fake the passage of time through
+ *	that hook see a consistent clock from both functions.
+ */
+int64_t get_monotonic_ns( void );
+
 // ------------------------------------------------------------------
 //	Advanced facilities to support automated testing.
 // ------------------------------------------------------------------
@@ -121,7 +433,7 @@ double get_current_time( void );
  *	NOTE: This function is for internal use only. User code should NOT call 
  *	this function pointer directly.
  */
-void( *zdk_timer_pause )( long milliseconds );
+extern void( *zdk_timer_pause )( long milliseconds );
 
 /**
  *	Override: get_current_time().
@@ -142,7 +454,23 @@ void( *zdk_timer_pause )( long milliseconds );
  *	NOTE: This function is for internal use only. User code should NOT call
  *	this function pointer directly.
  */
-double( *zdk_get_current_time )( void );
+extern double( *zdk_get_current_time )( void );
+
+/**
+ *	Override: get_monotonic_ns().
+ *
+ *	This callback function, if not NULL, is used in place
+ *	of the default implementation of get_monotonic_ns().
+ *
+ *	Input: void.
+ *
+ *	Output: Returns a value which is treated as the current
+ *			monotonic time, measured in whole nanoseconds.
+ *
+ *	NOTE: This function is for internal use only. User code should NOT call
+ *	this function pointer directly.
+ */
+extern int64_t( *zdk_get_monotonic_ns )( void );
 
 /**
  *	Determines if two timers have the same reset time and expiry period.
@@ -0,0 +1,718 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "batch.h"
+
+// Number of steps between timer callbacks.
+#define CHEESE_STEPS (CHEESE_INTERVAL / DELAY)
+#define TRAP_STEPS (TRAP_INTERVAL / DELAY)
+#define FIREWORK_STEPS (FIREWORK_INTERVAL / DELAY)
+
+// Bits of GameBatch.events. Bit i of EVENT_CHEESE and bit i of EVENT_TRAP stand for slot i.
+#define EVENT_CHEESE 0x1f
+#define EVENT_TRAP 0x3e0
+#define EVENT_TRAP_SHIFT 5
+#define EVENT_DOOR 0x400
+#define EVENT_TOM 0x800
+#define EVENT_CHEESE_TIMER 0x1000
+#define EVENT_TRAP_TIMER 0x2000
+#define EVENT_FIREWORK_TIMER 0x4000
+#define EVENT_TOM_BLOCKED 0x8000
+#define EVENT_JERRY_BLOCKED 0x10000
+
+// Helpers called from the vector loops, which only vectorise if every call in them is inlined.
+#define VECTOR_INLINE static inline __attribute__((always_inline))
+
+// Allocate a zeroed array of count elements of size bytes each, aligned for vector loads.
+static void *batch_array(size_t count, size_t size)
+{
+    void *array;
+
+    if (posix_memalign(&array, 64, count * size) != 0)
+    {
+        abort();
+    }
+
+    memset(array, 0, count * size);
+    return array;
+}
+
+// Returns the cell a non-negative coordinate rounds to, as round() does, but in a form which vectorises.
+VECTOR_INLINE int round_cell(float position)
+{
+    return (int)(position + 0.5f);
+}
+
+// Returns the index of (x, y), any cell of the room or of the border around it, in the bordered grid of room.
+VECTOR_INLINE int cell_index(const BatchRoom *room, int x, int y)
+{
+    return (y + 1) * room->stride + x + 1;
+}
+
+// Returns 1 if (x, y) is a wall, for any cell of the room or of the border around it.
+VECTOR_INLINE int wall_at(const BatchRoom *room, int x, int y)
+{
+    return room->walls[cell_index(room, x, y)];
+}
+
+// Returns 1 if (x, y) is inside the play area and not a wall, like path_walkable() on the room's path grid.
+VECTOR_INLINE int walkable(const BatchRoom *room, int x, int y)
+{
+    return room->column[cell_index(room, x, y)] != room->count;
+}
+
+// Returns the path from cell index from to cell index to, as held in room->paths.
+VECTOR_INLINE int path_between(const BatchRoom *room, int from, int to)
+{
+    return room->paths[room->row[from] + room->column[to]];
+}
+
+// Returns the smaller of nearest and the cost of the path from cell index from to slot of xs and ys for game k.
+// An empty slot, at (-1, -1), is the corner of the border, which no path reaches.
+VECTOR_INLINE int nearer(const GameBatch *batch, const BatchRoom *room, const int *xs, const int *ys, int slot, int k, int from, int nearest)
+{
+    int cost = path_between(room, from, cell_index(room, xs[slot * batch->capacity + k], ys[slot * batch->capacity + k])) >> 4;
+
+    return cost < nearest ? cost : nearest;
+}
+
+// Returns the cost of the path from cell index from to the nearest of the five slots of xs and ys for game k, or BATCH_FAR.
+// The slots are written out, as the loops calling this only vectorise once it has no loop of its own.
+VECTOR_INLINE int nearest(const GameBatch *batch, const BatchRoom *room, const int *xs, const int *ys, int k, int from)
+{
+    int cost = BATCH_FAR;
+
+    cost = nearer(batch, room, xs, ys, 0, k, from, cost);
+    cost = nearer(batch, room, xs, ys, 1, k, from, cost);
+    cost = nearer(batch, room, xs, ys, 2, k, from, cost);
+    cost = nearer(batch, room, xs, ys, 3, k, from, cost);
+    return nearer(batch, room, xs, ys, 4, k, from, cost);
+}
+
+// Returns the contribution to the influence of a source at a path cost of cost, like influence_at() for one distance map
+// with a limit of range cells.
+VECTOR_INLINE float influence_term(float weight, int cost, int range)
+{
+    int limit = range * PATH_STRAIGHT_COST;
+
+    return cost <= limit ? weight * (1 - (float)cost / (limit + PATH_STRAIGHT_COST)) : 0;
+}
+
+// Returns the influence of cell (x, y) on Jerry in game k: the attraction of cheese and the door, less the danger of Tom and traps,
+// over the ranges of ai, each measured along the paths of the room.
+VECTOR_INLINE float influence(const GameBatch *batch, const BatchRoom *room, const AiParams *ai, int k, int x, int y)
+{
+    int from = cell_index(room, x, y);
+    int tom = path_between(room, from, cell_index(room, round_cell(batch->tom_x[k]), round_cell(batch->tom_y[k]))) >> 4;
+
+    return influence_term(1, nearest(batch, room, batch->cheese_x, batch->cheese_y, k, from), ai->cheese_range) +
+           influence_term(0.5f, nearer(batch, room, batch->door_x, batch->door_y, 0, k, from, BATCH_FAR), ai->door_range) +
+           influence_term(-3, tom, ai->tom_range) +
+           influence_term(-2, nearest(batch, room, batch->trap_x, batch->trap_y, k, from), ai->trap_range);
+}
+
+// Set target_x and target_y to where a player at (x, y) heads for on its way to (to_x, to_y): the middle of the next
+// cell along the path from its cell to theirs, as along a flow field, or straight at (to_x, to_y) if there is no path.
+VECTOR_INLINE void head_for(const BatchRoom *room, float x, float y, float to_x, float to_y, float *target_x, float *target_y)
+{
+    int cell_x = round_cell(x), cell_y = round_cell(y);
+    int path = path_between(room, cell_index(room, cell_x, cell_y), cell_index(room, round_cell(to_x), round_cell(to_y)));
+    int step_x = ((path >> 2) & 3) - 1, step_y = (path & 3) - 1;
+    int step = (step_x != 0) | (step_y != 0);
+
+    *target_x = step ? cell_x + step_x : to_x;
+    *target_y = step ? cell_y + step_y : to_y;
+}
+
+// Move a player at x and y by dx and dy, or along only one of them if a wall or the edge of the room is in the way of
+// the other, as move_auto_player() does. Does nothing unless active is set.
+VECTOR_INLINE void slide(const BatchRoom *room, int active, float *x, float *y, float dx, float dy)
+{
+    int cell_x = round_cell(*x), cell_y = round_cell(*y);
+    int sign_x = (dx > 0) - (dx < 0), sign_y = (dy > 0) - (dy < 0);
+    int free_x = active & !wall_at(room, cell_x + sign_x, cell_y) & (cell_x + dx < room->width - 1) & (cell_x + dx > 0);
+    int free_y = active & !wall_at(room, cell_x, cell_y + sign_y) & (cell_y + dy < room->height - 1) & (cell_y + dy > 5);
+
+    *x += free_x ? dx : 0;
+    *y += free_y ? dy : 0;
+}
+
+// Returns bit if Jerry, at (x, y), is on slot of xs and ys for game k, or 0.
+VECTOR_INLINE int landed_on(const GameBatch *batch, const int *xs, const int *ys, int slot, int k, int x, int y, int bit)
+{
+    return ((xs[slot * batch->capacity + k] == x) & (ys[slot * batch->capacity + k] == y)) ? bit : 0;
+}
+
+// Pick a new random step for a wandering player, as move_random() does when blocked.
+static void pick_step(Rng *rng, double min_speed, float *dx, float *dy)
+{
+    double speed = rng_unit(rng) * min_speed + min_speed;
+    double direction = rng_unit(rng) * M_PI * 2;
+
+    *dx = cos(direction) * speed;
+    *dy = sin(direction) * speed;
+}
+
+// Move the player at x and y of each game flagged in moving along its step, as move_random() does. Games whose player
+// is blocked by a wall or the edge of the room are flagged with blocked in events, to pick a new step.
+static void wander(GameBatch *batch, float *x, float *y, const float *dx, const float *dy, int blocked)
+{
+    int capacity = batch->capacity;
+    BatchRoom room = *batch->room;
+    float right = room.width - 1, bottom = room.height - 1;
+
+#pragma omp simd
+    for (int k = 0; k < capacity; k++)
+    {
+        float from_x = x[k], from_y = y[k], next_x = from_x + dx[k], next_y = from_y + dy[k];
+        int cell_x = round_cell(from_x), cell_y = round_cell(from_y);
+        int sign_x = (dx[k] > 0) - (dx[k] < 0), sign_y = (dy[k] > 0) - (dy[k] < 0);
+        int stuck = (next_x > right) | (next_x < 0) | (next_y > bottom) | (next_y < 5) | wall_at(&room, cell_x + sign_x, cell_y + sign_y) |
+                    wall_at(&room, cell_x + sign_x, cell_y) | wall_at(&room, cell_x, cell_y + sign_y);
+        int move = batch->moving[k] & !stuck;
+
+        x[k] = (move & (next_x < right) & (next_x > 0)) ? next_x : from_x;
+        y[k] = (move & (next_y < bottom) & (next_y > 5)) ? next_y : from_y;
+        batch->events[k] |= (batch->moving[k] & stuck) ? blocked : 0;
+    }
+}
+
+// Fly each firework along the path to Tom, turning by at most FIREWORK_TURN a step, as firework_homing() does, and flag
+// the games where one hits him.
+static void fly_fireworks(GameBatch *batch)
+{
+    int capacity = batch->capacity;
+    BatchRoom room = *batch->room;
+    float right = room.width - 1, bottom = room.height - 1;
+    float turn_cos = cosf(FIREWORK_TURN), turn_sin = sinf(FIREWORK_TURN), speed = batch->ai.firework_speed;
+
+#pragma omp simd
+    for (int k = 0; k < capacity; k++)
+    {
+        float x = batch->firework_x[k], y = batch->firework_y[k], tom_x = batch->tom_x[k], tom_y = batch->tom_y[k];
+        float heading_x = batch->firework_dx[k] / speed, heading_y = batch->firework_dy[k] / speed;
+        int flying = (batch->result[k] == BATCH_PLAYING) & (x != -1);
+        int hit = flying & (round_cell(x) == round_cell(tom_x)) & (round_cell(y) == round_cell(tom_y));
+
+        // Turn the heading towards the next cell on the way to Tom, rotating it by the largest turn allowed if that is
+        // further round.
+        float target_x, target_y;
+        head_for(&room, x, y, tom_x, tom_y, &target_x, &target_y);
+
+        float to_x = target_x - x, to_y = target_y - y;
+        float d = sqrtf(to_x * to_x + to_y * to_y);
+        float scale = d > 0 ? 1 / d : 0;
+        to_x = d > 0 ? to_x * scale : heading_x;
+        to_y = d > 0 ? to_y * scale : heading_y;
+
+        float side = heading_x * to_y - heading_y * to_x >= 0 ? turn_sin : -turn_sin;
+        int sharp = heading_x * to_x + heading_y * to_y < turn_cos;
+        float new_x = sharp ? heading_x * turn_cos - heading_y * side : to_x;
+        float new_y = sharp ? heading_x * side + heading_y * turn_cos : to_y;
+
+        float next_x = x + new_x * speed, next_y = y + new_y * speed;
+        int inside = (next_x < right) & (next_x > 1) & (next_y < bottom) & (next_y > 5);
+        int clear = inside & !wall_at(&room, round_cell(next_x), round_cell(next_y));
+        int move = flying & !hit & clear;
+
+        // A firework which stops, by hitting Tom or a wall, is gone, and so is one which was not flying.
+        batch->firework_dx[k] = new_x * speed;
+        batch->firework_dy[k] = new_y * speed;
+        batch->firework_x[k] = move ? next_x : -1;
+        batch->firework_y[k] = move ? next_y : -1;
+        batch->hit[k] = hit;
+    }
+}
+
+// Move Tom along the path to Jerry, or straight towards him if there is none, sliding along walls, as update_tom_advanced()
+// does, first putting him back where he started if a firework hit him.
+static void chase_jerry(GameBatch *batch)
+{
+    int capacity = batch->capacity;
+    BatchRoom room = *batch->room;
+    float start_x = room.tom_start_x, start_y = room.tom_start_y, speed = batch->ai.chase_speed;
+
+#pragma omp simd
+    for (int k = 0; k < capacity; k++)
+    {
+        float x = batch->hit[k] ? start_x : batch->tom_x[k], y = batch->hit[k] ? start_y : batch->tom_y[k];
+        float target_x, target_y;
+        head_for(&room, x, y, batch->jerry_x[k], batch->jerry_y[k], &target_x, &target_y);
+
+        float to_x = target_x - x, to_y = target_y - y;
+        float d = sqrtf(to_x * to_x + to_y * to_y);
+        float scale = d > 0 ? speed / d : 0;
+
+        slide(&room, batch->result[k] == BATCH_PLAYING, &x, &y, to_x * scale, to_y * scale);
+        batch->tom_x[k] = x;
+        batch->tom_y[k] = y;
+    }
+}
+
+// Move Jerry's best cell so far, at best_x and best_y with an influence of best, to the neighbouring cell dx, dy from
+// his cell (x, y) in game k if he can step there and its influence is higher. Diagonal steps need both cells beside
+// them to be clear too.
+VECTOR_INLINE void consider_step(const GameBatch *batch, const BatchRoom *room, const AiParams *ai, int k, int x, int y, int dx, int dy,
+                                 float *best, int *best_x, int *best_y)
+{
+    int open = walkable(room, x + dx, y + dy) & (dx == 0 || dy == 0 || (walkable(room, x + dx, y) & walkable(room, x, y + dy)));
+    float value = influence(batch, room, ai, k, x + dx, y + dy);
+    int better = open & (value > *best);
+
+    *best = better ? value : *best;
+    *best_x = better ? x + dx : *best_x;
+    *best_y = better ? y + dy : *best_y;
+}
+
+// Move Jerry towards whichever neighbouring cell has the highest influence, sliding along walls, or wander if none beats
+// his own, as follow_influence() does.
+static void follow_influence_batch(GameBatch *batch)
+{
+    int capacity = batch->capacity;
+    BatchRoom room = *batch->room;
+    AiParams ai = batch->ai;
+    float speed = ai.jerry_speed;
+
+#pragma omp simd
+    for (int k = 0; k < capacity; k++)
+    {
+        float jerry_x = batch->jerry_x[k], jerry_y = batch->jerry_y[k];
+        int x = round_cell(jerry_x), y = round_cell(jerry_y), best_x = x, best_y = y;
+        float best = influence(batch, &room, &ai, k, x, y);
+
+        // The neighbours are written out, in the order of follow_influence(), as this only vectorises with no inner loop.
+        consider_step(batch, &room, &ai, k, x, y, -1, -1, &best, &best_x, &best_y);
+        consider_step(batch, &room, &ai, k, x, y, 0, -1, &best, &best_x, &best_y);
+        consider_step(batch, &room, &ai, k, x, y, 1, -1, &best, &best_x, &best_y);
+        consider_step(batch, &room, &ai, k, x, y, -1, 0, &best, &best_x, &best_y);
+        consider_step(batch, &room, &ai, k, x, y, 1, 0, &best, &best_x, &best_y);
+        consider_step(batch, &room, &ai, k, x, y, -1, 1, &best, &best_x, &best_y);
+        consider_step(batch, &room, &ai, k, x, y, 0, 1, &best, &best_x, &best_y);
+        consider_step(batch, &room, &ai, k, x, y, 1, 1, &best, &best_x, &best_y);
+
+        int active = batch->result[k] == BATCH_PLAYING;
+        int stay = (walkable(&room, x, y) == 0) | ((best_x == x) & (best_y == y));
+        float to_x = best_x - jerry_x, to_y = best_y - jerry_y;
+        float d = sqrtf(to_x * to_x + to_y * to_y);
+        float scale = d > 0 ? speed / d : 0;
+
+        slide(&room, active & !stay, &jerry_x, &jerry_y, to_x * scale, to_y * scale);
+        batch->jerry_x[k] = jerry_x;
+        batch->jerry_y[k] = jerry_y;
+        batch->moving[k] = active & stay;
+    }
+
+    wander(batch, batch->jerry_x, batch->jerry_y, batch->jerry_dx, batch->jerry_dy, EVENT_JERRY_BLOCKED);
+}
+
+// Flag Jerry landing on cheese, a trap, the door or Tom, and timers firing, for each game.
+static void find_events(GameBatch *batch)
+{
+    int capacity = batch->capacity;
+
+#pragma omp simd
+    for (int k = 0; k < capacity; k++)
+    {
+        int x = round_cell(batch->jerry_x[k]), y = round_cell(batch->jerry_y[k]);
+        int active = batch->result[k] == BATCH_PLAYING;
+        int cheese_timer = batch->cheese_timer[k] - active, trap_timer = batch->trap_timer[k] - active;
+        int firework_timer = batch->firework_timer[k] - active;
+        int events = 0;
+
+        events |= landed_on(batch, batch->cheese_x, batch->cheese_y, 0, k, x, y, 1 << 0);
+        events |= landed_on(batch, batch->cheese_x, batch->cheese_y, 1, k, x, y, 1 << 1);
+        events |= landed_on(batch, batch->cheese_x, batch->cheese_y, 2, k, x, y, 1 << 2);
+        events |= landed_on(batch, batch->cheese_x, batch->cheese_y, 3, k, x, y, 1 << 3);
+        events |= landed_on(batch, batch->cheese_x, batch->cheese_y, 4, k, x, y, 1 << 4);
+        events |= landed_on(batch, batch->trap_x, batch->trap_y, 0, k, x, y, 1 << (EVENT_TRAP_SHIFT + 0));
+        events |= landed_on(batch, batch->trap_x, batch->trap_y, 1, k, x, y, 1 << (EVENT_TRAP_SHIFT + 1));
+        events |= landed_on(batch, batch->trap_x, batch->trap_y, 2, k, x, y, 1 << (EVENT_TRAP_SHIFT + 2));
+        events |= landed_on(batch, batch->trap_x, batch->trap_y, 3, k, x, y, 1 << (EVENT_TRAP_SHIFT + 3));
+        events |= landed_on(batch, batch->trap_x, batch->trap_y, 4, k, x, y, 1 << (EVENT_TRAP_SHIFT + 4));
+        events |= landed_on(batch, batch->door_x, batch->door_y, 0, k, x, y, EVENT_DOOR);
+        events |= ((round_cell(batch->tom_x[k]) == x) & (round_cell(batch->tom_y[k]) == y)) ? EVENT_TOM : 0;
+        events |= cheese_timer == 0 ? EVENT_CHEESE_TIMER : 0;
+        events |= trap_timer == 0 ? EVENT_TRAP_TIMER : 0;
+        events |= firework_timer == 0 ? EVENT_FIREWORK_TIMER : 0;
+
+        batch->cheese_timer[k] = cheese_timer;
+        batch->trap_timer[k] = trap_timer;
+        batch->firework_timer[k] = firework_timer;
+        batch->events[k] |= events * active;
+        batch->steps[k] += active;
+    }
+}
+
+// Returns true if nothing occupies cell (x, y) of game k, like cell_at() returning an empty cell.
+static bool cell_free(const GameBatch *batch, int k, int x, int y)
+{
+    if (!walkable(batch->room, x, y) || (x == batch->door_x[k] && y == batch->door_y[k]))
+    {
+        return false;
+    }
+
+    if (batch->firework_x[k] != -1 && x == round_cell(batch->firework_x[k]) && y == round_cell(batch->firework_y[k]))
+    {
+        return false;
+    }
+
+    for (int i = 0; i < 5; i++)
+    {
+        int slot = i * batch->capacity + k;
+
+        if ((x == batch->trap_x[slot] && y == batch->trap_y[slot]) || (x == batch->cheese_x[slot] && y == batch->cheese_y[slot]))
+        {
+            return false;
+        }
+    }
+
+    return !(x == round_cell(batch->tom_x[k]) && y == round_cell(batch->tom_y[k])) && !(x == round_cell(batch->jerry_x[k]) && y == round_cell(batch->jerry_y[k]));
+}
+
+// Pick a random cell of game k, as place_cheese() and check_win() do. Returns false if it is occupied.
+static bool random_cell(GameBatch *batch, int k, int *x, int *y)
+{
+    *x = round(rng_unit(&batch->rng[k]) * (batch->room->width - 1));
+    *y = round(rng_unit(&batch->rng[k]) * (batch->room->height - 4)) + 4;
+    return cell_free(batch, k, *x, *y);
+}
+
+// Put Tom and Jerry back where they started and take one of Jerry's lives, as lose_life() does.
+static void lose_life_batch(GameBatch *batch, int k)
+{
+    batch->jerry_x[k] = batch->room->jerry_start_x;
+    batch->jerry_y[k] = batch->room->jerry_start_y;
+    batch->tom_x[k] = batch->room->tom_start_x;
+    batch->tom_y[k] = batch->room->tom_start_y;
+
+    if (--batch->lives[k] == 0)
+    {
+        batch->result[k] = BATCH_TOM_WON;
+    }
+}
+
+// Handle the events found for game k in the current step, in the order check_jerry_collisions() and the timers do.
+static void handle_events(GameBatch *batch, int k)
+{
+    int events = batch->events[k];
+
+    if (events & EVENT_TOM_BLOCKED)
+    {
+        pick_step(&batch->rng[k], batch->ai.min_speed, &batch->tom_dx[k], &batch->tom_dy[k]);
+    }
+
+    if (events & EVENT_JERRY_BLOCKED)
+    {
+        pick_step(&batch->rng[k], batch->ai.min_speed, &batch->jerry_dx[k], &batch->jerry_dy[k]);
+    }
+
+    if (events & EVENT_DOOR)
+    {
+        batch->result[k] = BATCH_JERRY_WON;
+        return;
+    }
+
+    if (events & EVENT_TOM)
+    {
+        lose_life_batch(batch, k);
+    }
+
+    for (int i = 0; i < 5 && batch->result[k] == BATCH_PLAYING; i++)
+    {
+        int slot = i * batch->capacity + k;
+
+        if (events & (1 << i))
+        {
+            batch->cheese_x[slot] = batch->cheese_y[slot] = -1;
+            batch->cheese[k]--;
+            batch->cheese_collected[k]++;
+
+            if (batch->cheese_collected[k] == 5 && batch->door_x[k] == -1)
+            {
+                int x, y;
+
+                while (!random_cell(batch, k, &x, &y))
+                {
+                }
+
+                batch->door_x[k] = x;
+                batch->door_y[k] = y;
+            }
+        }
+
+        if (events & (1 << (EVENT_TRAP_SHIFT + i)))
+        {
+            batch->trap_x[slot] = batch->trap_y[slot] = -1;
+            batch->traps[k]--;
+            lose_life_batch(batch, k);
+        }
+    }
+
+    if (batch->result[k] != BATCH_PLAYING)
+    {
+        return;
+    }
+
+    if (events & EVENT_CHEESE_TIMER)
+    {
+        int x, y;
+
+        if (batch->cheese[k] < 5 && random_cell(batch, k, &x, &y))
+        {
+            for (int i = 0; i < 5; i++)
+            {
+                if (batch->cheese_x[i * batch->capacity + k] == -1)
+                {
+                    batch->cheese_x[i * batch->capacity + k] = x;
+                    batch->cheese_y[i * batch->capacity + k] = y;
+                    batch->cheese[k]++;
+                    break;
+                }
+            }
+        }
+        batch->cheese_timer[k] = CHEESE_STEPS;
+    }
+
+    if (events & EVENT_TRAP_TIMER)
+    {
+        for (int i = 0; i < 5; i++)
+        {
+            if (batch->trap_x[i * batch->capacity + k] == -1)
+            {
+                batch->trap_x[i * batch->capacity + k] = round_cell(batch->tom_x[k]);
+                batch->trap_y[i * batch->capacity + k] = round_cell(batch->tom_y[k]);
+                batch->traps[k]++;
+                break;
+            }
+        }
+        batch->trap_timer[k] = TRAP_STEPS;
+    }
+
+    if (events & EVENT_FIREWORK_TIMER)
+    {
+        if (batch->chase)
+        {
+            // Launched along the path to Tom, as shoot_firework() does.
+            float target_x, target_y;
+            head_for(batch->room, batch->jerry_x[k], batch->jerry_y[k], batch->tom_x[k], batch->tom_y[k], &target_x, &target_y);
+
+            float to_x = target_x - batch->jerry_x[k], to_y = target_y - batch->jerry_y[k];
+            float d = sqrtf(to_x * to_x + to_y * to_y);
+
+            batch->firework_x[k] = batch->jerry_x[k];
+            batch->firework_y[k] = batch->jerry_y[k];
+            batch->firework_dx[k] = d > 0 ? to_x / d * batch->ai.firework_speed : batch->ai.firework_speed;
+            batch->firework_dy[k] = d > 0 ? to_y / d * batch->ai.firework_speed : 0;
+        }
+        batch->firework_timer[k] = FIREWORK_STEPS;
+    }
+}
+
+bool batch_room_init(BatchRoom *room, GameState *game)
+{
+    int width = game->grid_width, height = game->grid_height;
+    int stride = width + 2, cells = stride * (height + 2);
+    int walkable_cells = 0;
+
+    for (int i = 0; i < width * height; i++)
+    {
+        walkable_cells += path_walkable(&game->room_paths, i % width, i / width);
+    }
+
+    if (walkable_cells > BATCH_MAX_CELLS)
+    {
+        *room = (BatchRoom){0};
+        room->count = walkable_cells;
+        return false;
+    }
+
+    room->width = width;
+    room->height = height;
+    room->stride = stride;
+    room->walls = batch_array(cells, sizeof(int));
+    room->row = batch_array(cells, sizeof(int));
+    room->column = batch_array(cells, sizeof(int));
+
+    room->jerry_start_x = game->jerry.initx;
+    room->jerry_start_y = game->jerry.inity;
+    room->tom_start_x = game->tom.initx;
+    room->tom_start_y = game->tom.inity;
+
+    // Number the walkable cells, and send every other cell of the bordered grid to the last, nowhere.
+    int *cell = malloc(width * height * sizeof(int));
+    room->count = 0;
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            room->walls[cell_index(room, x, y)] = game->room_grid[y * width + x] == WALL;
+
+            if (path_walkable(&game->room_paths, x, y))
+            {
+                room->column[cell_index(room, x, y)] = room->count;
+                cell[room->count++] = y * width + x;
+            }
+        }
+    }
+
+    for (int y = -1; y <= height; y++)
+    {
+        for (int x = -1; x <= width; x++)
+        {
+            int i = cell_index(room, x, y);
+
+            if (x < 0 || x >= width || y < 0 || y >= height || !path_walkable(&game->room_paths, x, y))
+            {
+                room->column[i] = room->count;
+            }
+            room->row[i] = room->column[i] * (room->count + 1);
+        }
+    }
+
+    // Fill in each column of the table from a flow field towards its cell, over the same grid as the game's own fields.
+    size_t size = room->count + 1;
+    FlowField field = {0};
+
+    room->paths = batch_array(size * size, sizeof(int));
+    for (size_t i = 0; i < size * size; i++)
+    {
+        room->paths[i] = (BATCH_FAR << 4) | (1 << 2) | 1;
+    }
+
+    flow_field_reset(&field, &game->room_paths);
+
+    for (int to = 0; to < room->count; to++)
+    {
+        flow_field_set_target(&field, &game->room_paths, cell[to] % width, cell[to] / width);
+        flow_field_update(&field, &game->room_paths, 0);
+
+        for (int from = 0; from < room->count; from++)
+        {
+            int x = cell[from] % width, y = cell[from] / width, dx = 0, dy = 0;
+            int cost = flow_field_distance(&field, x, y);
+
+            flow_field_step(&field, x, y, &dx, &dy);
+            room->paths[(size_t)from * size + to] = ((cost == -1 ? BATCH_FAR : cost) << 4) | ((dx + 1) << 2) | (dy + 1);
+        }
+    }
+
+    flow_field_free(&field);
+    free(cell);
+    return true;
+}
+
+void batch_room_free(BatchRoom *room)
+{
+    free(room->walls);
+    free(room->row);
+    free(room->column);
+    free(room->paths);
+}
+
+void batch_init(GameBatch *batch, const BatchRoom *room, const AiParams *ai, int count, uint64_t seed, bool chase)
+{
+    int capacity = (count + BATCH_ALIGN - 1) / BATCH_ALIGN * BATCH_ALIGN;
+
+    batch->count = count;
+    batch->capacity = capacity;
+    batch->playing = count;
+    batch->room = room;
+    batch->chase = chase;
+    batch->ai = *ai;
+
+    float **floats[] = {&batch->jerry_x, &batch->jerry_y, &batch->jerry_dx, &batch->jerry_dy, &batch->tom_x, &batch->tom_y,
+                        &batch->tom_dx, &batch->tom_dy, &batch->firework_x, &batch->firework_y, &batch->firework_dx,
+                        &batch->firework_dy};
+    int **ints[] = {&batch->door_x, &batch->door_y, &batch->cheese, &batch->traps, &batch->cheese_collected, &batch->lives,
+                    &batch->cheese_timer, &batch->trap_timer, &batch->firework_timer, &batch->steps, &batch->result,
+                    &batch->events, &batch->moving, &batch->hit};
+    int **slots[] = {&batch->cheese_x, &batch->cheese_y, &batch->trap_x, &batch->trap_y};
+
+    for (int i = 0; i < (int)(sizeof(floats) / sizeof(floats[0])); i++)
+    {
+        *floats[i] = batch_array(capacity, sizeof(float));
+    }
+    for (int i = 0; i < (int)(sizeof(ints) / sizeof(ints[0])); i++)
+    {
+        *ints[i] = batch_array(capacity, sizeof(int));
+    }
+    for (int i = 0; i < (int)(sizeof(slots) / sizeof(slots[0])); i++)
+    {
+        *slots[i] = batch_array(5 * capacity, sizeof(int));
+        memset(*slots[i], -1, 5 * capacity * sizeof(int));
+    }
+    batch->rng = batch_array(capacity, sizeof(Rng));
+
+    for (int k = 0; k < capacity; k++)
+    {
+        rng_seed(&batch->rng[k], seed + k);
+        pick_step(&batch->rng[k], batch->ai.min_speed, &batch->jerry_dx[k], &batch->jerry_dy[k]);
+        pick_step(&batch->rng[k], batch->ai.min_speed, &batch->tom_dx[k], &batch->tom_dy[k]);
+
+        batch->jerry_x[k] = room->jerry_start_x;
+        batch->jerry_y[k] = room->jerry_start_y;
+        batch->tom_x[k] = room->tom_start_x;
+        batch->tom_y[k] = room->tom_start_y;
+        batch->firework_x[k] = batch->firework_y[k] = -1;
+        batch->door_x[k] = batch->door_y[k] = -1;
+        batch->lives[k] = LIVES;
+        batch->cheese_timer[k] = CHEESE_STEPS;
+        batch->trap_timer[k] = TRAP_STEPS;
+        batch->firework_timer[k] = FIREWORK_STEPS;
+        batch->result[k] = BATCH_PLAYING;
+    }
+}
+
+void batch_step(GameBatch *batch)
+{
+    int capacity = batch->capacity;
+
+    memset(batch->events, 0, capacity * sizeof(int));
+
+    if (batch->chase)
+    {
+        fly_fireworks(batch);
+        chase_jerry(batch);
+    }
+    else
+    {
+#pragma omp simd
+        for (int k = 0; k < capacity; k++)
+        {
+            batch->moving[k] = batch->result[k] == BATCH_PLAYING;
+        }
+        wander(batch, batch->tom_x, batch->tom_y, batch->tom_dx, batch->tom_dy, EVENT_TOM_BLOCKED);
+    }
+
+    follow_influence_batch(batch);
+    find_events(batch);
+
+    for (int k = 0; k < batch->capacity; k++)
+    {
+        if (batch->events[k] != 0)
+        {
+            handle_events(batch, k);
+
+            if (batch->result[k] != BATCH_PLAYING && k < batch->count)
+            {
+                batch->playing--;
+            }
+        }
+    }
+}
+
+void batch_free(GameBatch *batch)
+{
+    void *arrays[] = {batch->jerry_x, batch->jerry_y, batch->jerry_dx, batch->jerry_dy, batch->tom_x, batch->tom_y,
+                      batch->tom_dx, batch->tom_dy, batch->firework_x, batch->firework_y, batch->firework_dx, batch->firework_dy,
+                      batch->door_x, batch->door_y, batch->cheese, batch->traps, batch->cheese_collected,
+                      batch->lives, batch->cheese_timer, batch->trap_timer, batch->firework_timer, batch->steps, batch->result,
+                      batch->events, batch->moving, batch->hit, batch->cheese_x, batch->cheese_y,
+                      batch->trap_x, batch->trap_y, batch->rng};
+
+    for (int i = 0; i < (int)(sizeof(arrays) / sizeof(arrays[0])); i++)
+    {
+        free(arrays[i]);
+    }
+}
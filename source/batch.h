@@ -0,0 +1,115 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "game.h"
+#include "rng.h"
+
+// Lockstep simulation of many games of the same room at once, for evaluating the automated players in bulk.
+//
+// The state of the games is held in struct-of-arrays form, one array per field with an element per game, so each part of
+// a step - Tom's and Jerry's movement, firework homing, pickup checks and timers - is a single loop over every game which
+// the compiler turns into vector instructions. Rarer events found by those loops, such as spawning cheese, losing a life
+// or bouncing off a wall, are then handled one game at a time.
+//
+// As every game plays in the same room, the paths between its cells are found once, up front, in a BatchRoom: for every
+// pair of cells, the cost of the cheapest path and its first step, as a flow field towards the second cell would give.
+// Tom and fireworks then follow the same paths as along the flow fields of game.c, and Jerry weighs the same influences
+// over the same path distances, each a lookup rather than a search. The one difference is that traps do not make paths
+// through them dearer for Jerry, as the trap cells differ from game to game; Jerry still keeps away from them.
+
+// Number of games the arrays are padded to a multiple of, so vector loops need no separate loop for the remainder.
+#define BATCH_ALIGN 16
+
+// Cost of the path between two cells of a BatchRoom with none, further than any range.
+#define BATCH_FAR (1 << 20)
+
+// Most walkable cells a BatchRoom can have. Its table of paths takes (cells + 1) squared ints, up to 64 MiB at this limit,
+// against about 25 MiB for a room of the default 100 by 30 terminal. Larger rooms have to be played as full games.
+#define BATCH_MAX_CELLS 4096
+
+// Outcome of a game of a batch.
+typedef enum
+{
+    BATCH_PLAYING,
+    BATCH_JERRY_WON,
+    BATCH_TOM_WON
+} BatchResult;
+
+// A room as every game of a batch sees it, shared read-only by any number of batches.
+typedef struct
+{
+    // Whether each cell is a wall, over a grid with an open border of one cell so the neighbours of any cell of the room
+    // can be read without checking bounds, and where Tom and Jerry start.
+    int width, height, stride;
+    int *walls;
+    float jerry_start_x, jerry_start_y, tom_start_x, tom_start_y;
+
+    // Paths between every pair of the count walkable cells of the room, and a last cell standing for nowhere, which no
+    // path reaches. Cell i = (y + 1) * stride + x + 1 of the bordered grid is row row[i] / (count + 1) and column column[i]
+    // of the table, and paths[row[i] + column[j]] holds the path from cell i to cell j as (cost << 4) | ((dx + 1) << 2) | (dy + 1)
+    // for its first step dx, dy, with no step where there is no path or cell i is cell j, and a cost of BATCH_FAR if no path.
+    int count;
+    int *row, *column, *paths;
+} BatchRoom;
+
+typedef struct
+{
+    // Number of games, and of games in the arrays, a multiple of BATCH_ALIGN. Games past count play along unreported.
+    int count, capacity;
+
+    // The room every game plays in.
+    const BatchRoom *room;
+
+    // Tom homes in on Jerry and Jerry fires fireworks, as from the second level on, rather than Tom wandering.
+    bool chase;
+
+    // The constants every game of the batch plays by.
+    AiParams ai;
+
+    // Per game, the positions of Tom, Jerry and the firework, and the steps they take when wandering or flying.
+    // A firework at x = -1 is not flying.
+    float *jerry_x, *jerry_y, *jerry_dx, *jerry_dy;
+    float *tom_x, *tom_y, *tom_dx, *tom_dy;
+    float *firework_x, *firework_y, *firework_dx, *firework_dy;
+
+    // Per game and slot, cheese_x[slot * capacity + game] and so on, or -1 for an empty slot, and the door, or -1 if
+    // it has not appeared.
+    int *cheese_x, *cheese_y, *trap_x, *trap_y;
+    int *door_x, *door_y;
+
+    // Per game: the cheese and traps in the room, the cheese collected and Jerry's lives, the steps until each timer
+    // fires, the steps played and the outcome.
+    int *cheese, *traps, *cheese_collected, *lives;
+    int *cheese_timer, *trap_timer, *firework_timer;
+    int *steps, *result;
+    Rng *rng;
+
+    // Per game, working space of the vector loops: events found in the current step, to be handled one game at a time,
+    // whether a player is wandering, and whether a firework hit Tom.
+    int *events, *moving, *hit;
+
+    // Number of the first count games still playing.
+    int playing;
+} GameBatch;
+
+// Find the paths between every pair of cells of the room loaded into game, along the same grid as its flow fields.
+// Returns false, leaving nothing to free and only count set, to the number of walkable cells, if there are more than
+// BATCH_MAX_CELLS of them.
+bool batch_room_init(BatchRoom *room, GameState *game);
+
+// Release the memory held by the room.
+void batch_room_free(BatchRoom *room);
+
+// Start count games in room, with the automated players governed by ai, game i seeded with seed + i.
+// With chase set, the games are played as a level after the first, with Tom chasing Jerry.
+void batch_init(GameBatch *batch, const BatchRoom *room, const AiParams *ai, int count, uint64_t seed, bool chase);
+
+// Advance every game still playing by one fixed timestep of DELAY milliseconds.
+void batch_step(GameBatch *batch);
+
+// Release the memory held by the batch.
+void batch_free(GameBatch *batch);
+
+#endif
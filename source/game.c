@@ -0,0 +1,1043 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <cab202_graphics.h>
+#include <cab202_timers.h>
+#include "game.h"
+
+const AiParams default_ai = {MINSPEED, CHASE_SPEED, JERRY_SPEED, FIREWORK_SPEED, CHEESE_RANGE, DOOR_RANGE, TOM_RANGE, TRAP_RANGE};
+
+////////////////////////////////////////////////////
+/////////////////GAMEPLAY FUNCTIONS/////////////////
+
+void load_room(GameState *game, FILE *stream)
+{
+    game->grid_width = WIDTH(game);
+    game->grid_height = HEIGHT(game);
+    game->room_grid = realloc(game->room_grid, game->grid_width * game->grid_height);
+    memset(game->room_grid, ' ', game->grid_width * game->grid_height);
+
+    while (!feof(stream))
+    {
+        char command;
+        double x1, y1, x2, y2;
+
+        int arg_count = fscanf(stream, "%c %lf %lf %lf %lf", &command, &x1, &y1, &x2, &y2);
+
+        if (arg_count == 3 && game->setup_players < 2)
+        {
+            if (command == 'T')
+            {
+                game->tom.initx = round(x1 * (WIDTH(game) - 1));
+                if (round(y1 * (HEIGHT(game)) + 5) > HEIGHT(game))
+                {
+                    game->tom.inity = round(y1 * (HEIGHT(game))-1);
+                }
+                else
+                {
+                    game->tom.inity = round(y1 * (HEIGHT(game)) + 5);
+                }
+                game->tom.xpos = game->tom.initx;
+                game->tom.ypos = game->tom.inity;
+                game->tom.symbol = 'T';
+            }
+            else if (command == 'J')
+            {
+                game->jerry.initx = round(x1 * (WIDTH(game) - 1));
+                if (round(y1 * (HEIGHT(game)) + 5) > HEIGHT(game))
+                {
+                    game->jerry.inity = round(y1 * (HEIGHT(game))-1);
+                }
+                else
+                {
+                    game->jerry.inity = round(y1 * (HEIGHT(game)) + 5);
+                }
+                game->jerry.xpos = game->jerry.initx;
+                game->jerry.ypos = game->jerry.inity;
+                game->jerry.symbol = 'J';
+            }
+            game->setup_players++;
+        }
+        else if (arg_count == 5)
+        {
+            if (command == 'W')
+            {
+                trace_line(round(x1 * WIDTH(game)), round(y1 * HEIGHT(game) + 4), round(x2 * WIDTH(game)), round(y2 * HEIGHT(game) + 4), plot_wall, game);
+            }
+        }
+    }
+
+    build_path_grid(game);
+    game->room_loaded = true;
+}
+
+void plot_wall(int x, int y, void *data)
+{
+    GameState *game = data;
+
+    if (x >= 0 && x < game->grid_width && y >= 0 && y < game->grid_height)
+    {
+        game->room_grid[y * game->grid_width + x] = WALL;
+    }
+}
+
+char cell_at(GameState *game, int x, int y, char ignore)
+{
+    if (x < 0 || y < 0 || x >= game->grid_width || y >= game->grid_height)
+    {
+        return -1;
+    }
+
+    if (y < 5)
+    {
+        return '-';
+    }
+
+    if (game->firework.symbol != ignore && x == round(game->firework.xpos) && y == round(game->firework.ypos))
+    {
+        return game->firework.symbol;
+    }
+
+    if (x == game->door_position[0] && y == game->door_position[1])
+    {
+        return 'X';
+    }
+
+    for (int i = 0; i < 5; i++)
+    {
+        if (x == game->trap_positions[i][0] && y == game->trap_positions[i][1])
+        {
+            return '#';
+        }
+    }
+
+    for (int i = 0; i < 5; i++)
+    {
+        if (x == game->cheese_positions[i][0] && y == game->cheese_positions[i][1])
+        {
+            return '>';
+        }
+    }
+
+    if (game->tom.symbol != ignore && x == round(game->tom.xpos) && y == round(game->tom.ypos))
+    {
+        return game->tom.symbol;
+    }
+
+    if (game->jerry.symbol != ignore && x == round(game->jerry.xpos) && y == round(game->jerry.ypos))
+    {
+        return game->jerry.symbol;
+    }
+
+    return game->room_grid[y * game->grid_width + x];
+}
+
+void check_win(GameState *game)
+{
+    if (game->door_position[0] == -1 && (game->cheese_collected == 5 || game->tom.level_points >= 5))
+    {
+        int x, y;
+
+        do
+        {
+            x = round(rng_unit(&game->rng) * (WIDTH(game) - 1));
+            y = round(rng_unit(&game->rng) * (HEIGHT(game) - 4)) + 4;
+        } while (cell_at(game, x, y, 0) != ' ');
+
+        game->door_position[0] = x;
+        game->door_position[1] = y;
+        add_influence(game, &game->door_map, x, y);
+    }
+}
+
+double firework_heading(GameState *game)
+{
+    int x = round(game->firework.xpos), y = round(game->firework.ypos), step_x, step_y;
+    double target_x = game->tom.xpos, target_y = game->tom.ypos;
+
+    if (flow_field_step(&game->tom_flow, x, y, &step_x, &step_y))
+    {
+        target_x = x + step_x;
+        target_y = y + step_y;
+    }
+
+    return atan2(target_y - game->firework.ypos, target_x - game->firework.xpos);
+}
+
+void firework_homing(GameState *game)
+{
+    double turn = remainder(firework_heading(game) - game->firework.direction, 2 * M_PI);
+
+    if (turn > FIREWORK_TURN)
+    {
+        turn = FIREWORK_TURN;
+    }
+    else if (turn < -FIREWORK_TURN)
+    {
+        turn = -FIREWORK_TURN;
+    }
+    game->firework.direction += turn;
+
+    double dx = cos(game->firework.direction) * game->ai.firework_speed;
+    double dy = sin(game->firework.direction) * game->ai.firework_speed;
+
+    if (game->firework.xpos + dx < WIDTH(game) - 1 && game->firework.xpos + dx > 1 && game->firework.ypos + dy < HEIGHT(game) - 1 && game->firework.ypos + dy > 5 &&
+        cell_at(game, round(game->firework.xpos + dx), round(game->firework.ypos + dy), game->firework.symbol) != WALL)
+    {
+        game->firework.xpos += dx;
+        game->firework.ypos += dy;
+    }
+    else
+    {
+        game->firework.xpos = -1;
+        game->firework.ypos = -1;
+        game->fireworks--;
+    }
+}
+
+void shoot_firework(GameState *game)
+{
+    game->firework.xpos = game->jerry.xpos;
+    game->firework.ypos = game->jerry.ypos;
+    game->firework.direction = firework_heading(game);
+    game->fireworks++;
+}
+
+void update_firework(GameState *game)
+{
+    if (round(game->firework.xpos) == round(game->tom.xpos) && round(game->firework.ypos) == round(game->tom.ypos))
+    {
+        game->tom.xpos = game->tom.initx;
+        game->tom.ypos = game->tom.inity;
+
+        game->firework.xpos = -1;
+        game->firework.ypos = -1;
+        game->fireworks--;
+
+        if (game->current_player == 'J')
+        {
+            game->jerry.points++;
+        }
+    }
+    else if (game->firework.xpos != -1 && game->fireworks > 0 && !game->pause)
+    {
+        firework_homing(game);
+    }
+}
+
+void update_movement(GameState *game, int key_pressed, struct player *plyr)
+{
+    plyr->xpos = round(plyr->xpos);
+    plyr->ypos = round(plyr->ypos);
+    if (key_pressed == 'w' && plyr->ypos > 5 && !check_collision(game, *plyr, WALL, 0, -1))
+    {
+        plyr->ypos -= 1;
+    }
+    else if (key_pressed == 'a' && plyr->xpos > 0 && !check_collision(game, *plyr, WALL, -1, 0))
+    {
+        plyr->xpos -= 1;
+    }
+    else if (key_pressed == 's' && plyr->ypos < HEIGHT(game) - 1 && !check_collision(game, *plyr, WALL, 0, 1))
+    {
+        plyr->ypos += 1;
+    }
+    else if (key_pressed == 'd' && plyr->xpos < WIDTH(game) - 1 && !check_collision(game, *plyr, WALL, 1, 0))
+    {
+        plyr->xpos += 1;
+    }
+    else if (key_pressed == 'p')
+    {
+        paused(game);
+    }
+    else if (key_pressed == 'f' && game->firework.xpos == -1 && plyr->symbol == 'J' && game->current_level > 1)
+    {
+        shoot_firework(game);
+    }
+    else if (key_pressed == 'z' && game->current_level > 1 && !game->autoplay)
+    {
+        game->current_player = game->current_player == 'J' ? 'T' : 'J';
+    }
+    else if (key_pressed == 'o')
+    {
+        // Autoplay automates Jerry, so the player's side must be Jerry for Tom to be automated too.
+        game->autoplay = !game->autoplay;
+        game->current_player = 'J';
+    }
+    else if (key_pressed == 'g')
+    {
+        game->fast_forward = !game->fast_forward;
+    }
+    else if (key_pressed == 'm' && game->current_player == 'T' && game->traps < 5)
+    {
+        place_trap(game);
+    }
+    else if (key_pressed == 'c' && game->current_player == 'T' && game->cheese < 5)
+    {
+        place_cheese(game, 'M');
+    }
+}
+
+void check_cheese_trap_collisions(GameState *game)
+{
+    for (int i = 0; i < 5; i++)
+    {
+        if (game->current_player == 'J')
+        {
+            if (round(game->jerry.xpos) == game->cheese_positions[i][0] && round(game->jerry.ypos) == game->cheese_positions[i][1])
+            {
+                game->jerry.points++;
+                game->cheese_collected++;
+                collect_cheese(game, i);
+
+                check_win(game);
+            }
+
+            if (round(game->jerry.xpos) == game->trap_positions[i][0] && round(game->jerry.ypos) == game->trap_positions[i][1])
+            {
+                remove_trap(game, i);
+                lose_life(game);
+            }
+        }
+        else
+        {
+            if (round(game->jerry.xpos) == game->cheese_positions[i][0] && round(game->jerry.ypos) == game->cheese_positions[i][1])
+            {
+                collect_cheese(game, i);
+            }
+
+            if (round(game->jerry.xpos) == game->trap_positions[i][0] && round(game->jerry.ypos) == game->trap_positions[i][1])
+            {
+                remove_trap(game, i);
+                game->tom.points++;
+                game->tom.level_points++;
+
+                game->jerry.xpos = game->jerry.initx;
+                game->jerry.ypos = game->jerry.inity;
+
+                check_win(game);
+            }
+        }
+    }
+}
+
+void check_jerry_collisions(GameState *game)
+{
+    if (check_collision(game, game->jerry, 'X', 0, 0))
+    {
+        level_end(game, 'N');
+    }
+
+    if (check_collision(game, game->jerry, 'T', 0, 0))
+    {
+        lose_life(game);
+    }
+
+    check_cheese_trap_collisions(game);
+}
+
+void check_tom_collisions(GameState *game)
+{
+    if (check_collision(game, game->tom, 'J', 0, 0))
+    {
+        game->tom.points += 5;
+        game->tom.level_points += 5;
+        check_win(game);
+        game->jerry.xpos = game->jerry.initx;
+        game->jerry.ypos = game->jerry.inity;
+        game->tom.xpos = game->tom.initx;
+        game->tom.ypos = game->tom.inity;
+    }
+
+    if (check_collision(game, game->tom, 'X', 0, 0))
+    {
+        level_end(game, 'N');
+    }
+
+    if (check_collision(game, game->tom, '~', 0, 0))
+    {
+        game->firework.xpos = -1;
+        game->firework.ypos = -1;
+        game->fireworks--;
+        lose_life(game);
+    }
+}
+
+void update_player(GameState *game, int key_pressed, struct player *plyr)
+{
+    update_movement(game, key_pressed, plyr);
+
+    if (plyr->symbol == 'J')
+    {
+        check_jerry_collisions(game);
+    }
+    else
+    {
+        check_tom_collisions(game);
+    }
+}
+
+void update_tom(GameState *game)
+{
+    struct player *plyr = &game->tom;
+    move_random(game, plyr);
+}
+
+void move_random(GameState *game, struct player *plyr)
+{
+    double dx = cos(plyr->direction) * plyr->speed;
+    double dy = sin(plyr->direction) * plyr->speed;
+
+    if ((plyr->xpos + dx > WIDTH(game) - 1) || (plyr->xpos + dx < 0) || (plyr->ypos + dy > HEIGHT(game) - 1) || (plyr->ypos + dy < 5) || check_collision(game, *plyr, WALL, dx, dy) || check_collision(game, *plyr, WALL, dx, 0) || check_collision(game, *plyr, WALL, 0, dy))
+    {
+        plyr->speed = rng_unit(&game->rng) * game->ai.min_speed + game->ai.min_speed;
+        plyr->direction = rng_unit(&game->rng) * M_PI * 2;
+    }
+    else
+    {
+        if ((plyr->xpos + dx < WIDTH(game) - 1) && (plyr->xpos + dx > 0))
+        {
+            plyr->xpos += dx;
+        }
+
+        if (plyr->ypos + dy < HEIGHT(game) - 1 && plyr->ypos + dy > 5)
+        {
+            plyr->ypos += dy;
+        }
+    }
+}
+
+void move_auto_player(GameState *game, struct player *plyr, double dx, double dy)
+{
+    if (!check_collision(game, *plyr, WALL, dx, 0) && !check_collision(game, *plyr, WALL, 0, dy) && (round(plyr->xpos) + dx < WIDTH(game) - 1) && (round(plyr->xpos) + dx > 0) && (round(plyr->ypos) + dy < HEIGHT(game) - 1) && (round(plyr->ypos) + dy > 5))
+    {
+        plyr->xpos += dx;
+        plyr->ypos += dy;
+    }
+    else if (!check_collision(game, *plyr, WALL, dx, 0) && (round(plyr->xpos) + dx < WIDTH(game) - 1) && (round(plyr->xpos) + dx > 0))
+    {
+        plyr->xpos += dx;
+    }
+    else if (!check_collision(game, *plyr, WALL, 0, dy) && (round(plyr->ypos) + dy < HEIGHT(game) - 1) && (round(plyr->ypos) + dy > 5))
+    {
+        plyr->ypos += dy;
+    }
+}
+
+void build_path_grid(GameState *game)
+{
+    game->room_paths.width = game->grid_width;
+    game->room_paths.height = game->grid_height;
+    game->room_paths.cost = realloc(game->room_paths.cost, game->grid_width * game->grid_height);
+
+    for (int i = 0; i < game->grid_width * game->grid_height; i++)
+    {
+        game->room_paths.cost[i] = (i < 5 * game->grid_width || game->room_grid[i] == WALL) ? 0 : 1;
+    }
+
+    game->jerry_paths.width = game->grid_width;
+    game->jerry_paths.height = game->grid_height;
+    game->jerry_paths.cost = realloc(game->jerry_paths.cost, game->grid_width * game->grid_height);
+    memcpy(game->jerry_paths.cost, game->room_paths.cost, game->grid_width * game->grid_height);
+
+    for (int i = 0; i < 5; i++)
+    {
+        if (game->trap_positions[i][0] != -1 && path_walkable(&game->jerry_paths, game->trap_positions[i][0], game->trap_positions[i][1]))
+        {
+            game->jerry_paths.cost[game->trap_positions[i][1] * game->grid_width + game->trap_positions[i][0]] = TRAP_COST;
+        }
+    }
+
+    flow_field_reset(&game->jerry_flow, &game->room_paths);
+    flow_field_reset(&game->tom_flow, &game->room_paths);
+    path_hierarchy_build(&game->room_hierarchy, &game->room_paths, PATH_CLUSTER);
+
+    distance_map_reset(&game->cheese_map, &game->jerry_paths, game->ai.cheese_range * PATH_STRAIGHT_COST);
+    distance_map_reset(&game->door_map, &game->jerry_paths, game->ai.door_range * PATH_STRAIGHT_COST);
+    distance_map_reset(&game->tom_map, &game->room_paths, game->ai.tom_range * PATH_STRAIGHT_COST);
+    distance_map_reset(&game->trap_map, &game->room_paths, game->ai.trap_range * PATH_STRAIGHT_COST);
+
+    game->jerry_influence = realloc(game->jerry_influence, game->grid_width * game->grid_height * sizeof(double));
+    for (int i = 0; i < game->grid_width * game->grid_height; i++)
+    {
+        game->jerry_influence[i] = 0;
+    }
+
+    for (int i = 0; i < 5; i++)
+    {
+        if (game->cheese_positions[i][0] != -1)
+        {
+            add_influence(game, &game->cheese_map, game->cheese_positions[i][0], game->cheese_positions[i][1]);
+        }
+        if (game->trap_positions[i][0] != -1)
+        {
+            add_influence(game, &game->trap_map, game->trap_positions[i][0], game->trap_positions[i][1]);
+        }
+    }
+
+    if (game->door_position[0] != -1)
+    {
+        add_influence(game, &game->door_map, game->door_position[0], game->door_position[1]);
+    }
+
+    game->tom_source[0] = -1;
+    game->tom_source[1] = -1;
+    update_tom_influence(game);
+}
+
+void update_flow_fields(GameState *game)
+{
+    if (game->current_player == 'J' && game->current_level > 1)
+    {
+        flow_field_set_target(&game->jerry_flow, &game->room_paths, round(game->jerry.xpos), round(game->jerry.ypos));
+        flow_field_update(&game->jerry_flow, &game->room_paths, FLOW_BUDGET);
+    }
+
+    if (game->firework.xpos != -1)
+    {
+        flow_field_set_target(&game->tom_flow, &game->room_paths, round(game->tom.xpos), round(game->tom.ypos));
+        flow_field_update(&game->tom_flow, &game->room_paths, FLOW_BUDGET);
+    }
+}
+
+void move_towards(GameState *game, struct player *plyr, double x, double y, double speed)
+{
+    double t1 = x - plyr->xpos;
+    double t2 = y - plyr->ypos;
+    double d = sqrt(t1 * t1 + t2 * t2);
+
+    if (d == 0)
+    {
+        return;
+    }
+
+    move_auto_player(game, plyr, t1 * (speed / d), t2 * (speed / d));
+}
+
+bool follow_flow_field(GameState *game, struct player *plyr, const FlowField *field, double speed)
+{
+    int x = round(plyr->xpos), y = round(plyr->ypos), step_x, step_y;
+
+    if (!flow_field_step(field, x, y, &step_x, &step_y))
+    {
+        return false;
+    }
+
+    move_towards(game, plyr, x + step_x, y + step_y, speed);
+    return true;
+}
+
+bool follow_hierarchy(GameState *game, struct player *plyr, PathHierarchy *hierarchy, int x, int y, double speed)
+{
+    int from_x = round(plyr->xpos), from_y = round(plyr->ypos), waypoint, step;
+
+    if (path_hierarchy_find(hierarchy, &game->room_paths, from_x, from_y, x, y, &waypoint, 1) <= 0 ||
+        path_hierarchy_refine(hierarchy, &game->room_paths, from_x, from_y, waypoint % game->grid_width, waypoint / game->grid_width, &step, 1) <= 0)
+    {
+        return false;
+    }
+
+    move_towards(game, plyr, step % game->grid_width, step / game->grid_width, speed);
+    return true;
+}
+
+void update_tom_advanced(GameState *game)
+{
+    if (follow_flow_field(game, &game->tom, &game->jerry_flow, game->ai.chase_speed) || follow_hierarchy(game, &game->tom, &game->room_hierarchy, round(game->jerry.xpos), round(game->jerry.ypos), game->ai.chase_speed))
+    {
+        return;
+    }
+
+    move_towards(game, &game->tom, game->jerry.xpos, game->jerry.ypos, game->ai.chase_speed);
+}
+
+double influence_at(GameState *game, int i)
+{
+    const DistanceMap *maps[4] = {&game->cheese_map, &game->door_map, &game->tom_map, &game->trap_map};
+    const double weights[4] = {1, 0.5, -3, -2};
+    double influence = 0;
+
+    for (int k = 0; k < 4; k++)
+    {
+        if (maps[k]->distance[i] != -1)
+        {
+            influence += weights[k] * (1 - (double)maps[k]->distance[i] / (maps[k]->limit + PATH_STRAIGHT_COST));
+        }
+    }
+
+    return influence;
+}
+
+void refresh_influence(GameState *game, const DistanceMap *map)
+{
+    for (int i = 0; i < map->changed_count; i++)
+    {
+        game->jerry_influence[map->changed[i]] = influence_at(game, map->changed[i]);
+    }
+}
+
+const PathGrid *influence_grid(GameState *game, const DistanceMap *map)
+{
+    return (map == &game->cheese_map || map == &game->door_map) ? &game->jerry_paths : &game->room_paths;
+}
+
+void add_influence(GameState *game, DistanceMap *map, int x, int y)
+{
+    distance_map_add_source(map, influence_grid(game, map), x, y);
+    refresh_influence(game, map);
+}
+
+void remove_influence(GameState *game, DistanceMap *map, int x, int y)
+{
+    distance_map_remove_source(map, influence_grid(game, map), x, y);
+    refresh_influence(game, map);
+}
+
+void set_trap_cost(GameState *game, int x, int y, int cost)
+{
+    if (!path_walkable(&game->jerry_paths, x, y))
+    {
+        return;
+    }
+
+    int old_cost = game->jerry_paths.cost[y * game->grid_width + x];
+    game->jerry_paths.cost[y * game->grid_width + x] = cost;
+
+    distance_map_update_cell(&game->cheese_map, &game->jerry_paths, x, y, old_cost);
+    refresh_influence(game, &game->cheese_map);
+    distance_map_update_cell(&game->door_map, &game->jerry_paths, x, y, old_cost);
+    refresh_influence(game, &game->door_map);
+}
+
+void update_tom_influence(GameState *game)
+{
+    int x = round(game->tom.xpos), y = round(game->tom.ypos);
+
+    if (x == game->tom_source[0] && y == game->tom_source[1])
+    {
+        return;
+    }
+
+    if (game->tom_source[0] != -1)
+    {
+        remove_influence(game, &game->tom_map, game->tom_source[0], game->tom_source[1]);
+    }
+    add_influence(game, &game->tom_map, x, y);
+
+    game->tom_source[0] = x;
+    game->tom_source[1] = y;
+}
+
+void follow_influence(GameState *game)
+{
+    int x = round(game->jerry.xpos), y = round(game->jerry.ypos);
+    struct player *plyr = &game->jerry;
+
+    if (!path_walkable(&game->room_paths, x, y))
+    {
+        move_random(game, plyr);
+        return;
+    }
+
+    double best = game->jerry_influence[y * game->grid_width + x];
+    int best_x = x, best_y = y;
+
+    for (int dy = -1; dy <= 1; dy++)
+    {
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            if ((dx != 0 || dy != 0) && path_can_step(&game->room_paths, x, y, dx, dy) && game->jerry_influence[(y + dy) * game->grid_width + x + dx] > best)
+            {
+                best = game->jerry_influence[(y + dy) * game->grid_width + x + dx];
+                best_x = x + dx;
+                best_y = y + dy;
+            }
+        }
+    }
+
+    if (best_x == x && best_y == y)
+    {
+        move_random(game, plyr);
+    }
+    else
+    {
+        move_towards(game, plyr, best_x, best_y, game->ai.jerry_speed);
+    }
+}
+
+void collect_cheese(GameState *game, int i)
+{
+    remove_influence(game, &game->cheese_map, game->cheese_positions[i][0], game->cheese_positions[i][1]);
+    game->cheese_positions[i][0] = -1;
+    game->cheese_positions[i][1] = -1;
+    game->cheese--;
+}
+
+void remove_trap(GameState *game, int i)
+{
+    remove_influence(game, &game->trap_map, game->trap_positions[i][0], game->trap_positions[i][1]);
+    if (path_walkable(&game->room_paths, game->trap_positions[i][0], game->trap_positions[i][1]) && game->trap_map.sources[game->trap_positions[i][1] * game->grid_width + game->trap_positions[i][0]] == 0)
+    {
+        set_trap_cost(game, game->trap_positions[i][0], game->trap_positions[i][1], 1);
+    }
+    game->trap_positions[i][0] = -1;
+    game->trap_positions[i][1] = -1;
+    game->traps--;
+}
+
+void update_jerry(GameState *game)
+{
+    update_tom_influence(game);
+    follow_influence(game);
+    check_cheese_trap_collisions(game);
+}
+
+void update_enemy(GameState *game)
+{
+    if (!game->pause)
+    {
+        if (game->current_player == 'J')
+        {
+            if (game->current_level == 1)
+            {
+                update_tom(game);
+            }
+            else
+            {
+                update_tom_advanced(game);
+            }
+        }
+        else
+        {
+            update_jerry(game);
+        }
+    }
+}
+
+int check_collision(GameState *game, struct player plyr, char symbol, double xd, double yd)
+{
+    bool is_colliding = false;
+
+    if (xd > 0)
+    {
+        xd = 1;
+    }
+    else if (xd < 0)
+    {
+        xd = -1;
+    }
+
+    if (yd > 0)
+    {
+        yd = 1;
+    }
+    else if (yd < 0)
+    {
+        yd = -1;
+    }
+
+    if (cell_at(game, round(plyr.xpos) + xd, round(plyr.ypos) + yd, plyr.symbol) == symbol)
+    {
+        is_colliding = true;
+    }
+
+    return is_colliding;
+}
+
+void paused(GameState *game)
+{
+    game->pause = !game->pause;
+    if (game->pause)
+    {
+        game_clock_pause(game->game_clock);
+    }
+    else
+    {
+        game_clock_resume(game->game_clock);
+    }
+}
+
+void lose_life(GameState *game)
+{
+    game->jerry.xpos = game->jerry.initx;
+    game->jerry.ypos = game->jerry.inity;
+    game->tom.xpos = game->tom.initx;
+    game->tom.ypos = game->tom.inity;
+    if (game->current_player == 'J')
+    {
+        game->jerry.lives--;
+    }
+    else
+    {
+        game->tom.lives--;
+    }
+
+    if (game->jerry.lives == 0 || game->tom.lives == 0)
+    {
+        level_end(game, 'Q');
+    }
+}
+
+void spawn_cheese(void *context)
+{
+    GameState *game = context;
+
+    if (game->cheese < 5)
+    {
+        place_cheese(game, 'A');
+    }
+}
+
+void spawn_trap(void *context)
+{
+    GameState *game = context;
+
+    if (game->trap_supply > 0 && game->current_player != 'T')
+    {
+        place_trap(game);
+    }
+}
+
+void launch_firework(void *context)
+{
+    GameState *game = context;
+
+    if (game->current_player == 'T' || (game->autoplay && game->current_level > 1))
+    {
+        shoot_firework(game);
+    }
+}
+
+void place_trap(GameState *game)
+{
+    for (int i = 0; i < 5; i++)
+    {
+        if (game->trap_positions[i][0] == -1)
+        {
+            game->trap_positions[i][0] = round(game->tom.xpos);
+            game->trap_positions[i][1] = round(game->tom.ypos);
+            game->traps++;
+            add_influence(game, &game->trap_map, game->trap_positions[i][0], game->trap_positions[i][1]);
+            set_trap_cost(game, game->trap_positions[i][0], game->trap_positions[i][1], TRAP_COST);
+            break;
+        }
+    }
+    timer_reset(game->trap_timer);
+}
+
+void place_cheese(GameState *game, char auto_place)
+{
+    int x, y;
+    if (auto_place == 'A')
+    {
+        x = round(rng_unit(&game->rng) * (WIDTH(game) - 1));
+        y = round(rng_unit(&game->rng) * (HEIGHT(game) - 4)) + 4;
+
+        if (cell_at(game, x, y, 0) == ' ')
+        {
+            for (int i = 0; i < 5; i++)
+            {
+                if (game->cheese_positions[i][0] == -1)
+                {
+                    game->cheese_positions[i][0] = x;
+                    game->cheese_positions[i][1] = y;
+                    game->cheese++;
+                    add_influence(game, &game->cheese_map, x, y);
+                    break;
+                }
+            }
+        }
+    }
+    else
+    {
+        x = game->tom.xpos;
+        y = game->tom.ypos;
+        for (int i = 0; i < 5; i++)
+        {
+            if (game->cheese_positions[i][0] == -1)
+            {
+                game->cheese_positions[i][0] = x;
+                game->cheese_positions[i][1] = y;
+                game->cheese++;
+                add_influence(game, &game->cheese_map, x, y);
+                break;
+            }
+        }
+    }
+    timer_reset(game->cheese_timer);
+}
+
+void level_end(GameState *game, char condition)
+{
+    if (condition == 'Q')
+    {
+        game->level_over = true;
+        game_clock_pause(game->game_clock);
+        game->jerry.points = 0;
+        game->tom.points = 0;
+        game->jerry.lives = LIVES;
+        game->tom.lives = LIVES;
+    }
+    else if (condition == 'N')
+    {
+        game->current_level++;
+        setup(game);
+    }
+}
+
+void update_world(GameState *game)
+{
+    update_flow_fields(game);
+    update_firework(game);
+    update_enemy(game);
+    if (game->autoplay)
+    {
+        update_autoplay(game);
+    }
+    timer_wheel_advance(game->game_timers, 1);
+}
+
+void update_autoplay(GameState *game)
+{
+    update_tom_influence(game);
+    follow_influence(game);
+    check_jerry_collisions(game);
+}
+
+void advance_game(GameState *game, char *current_room, int steps)
+{
+    if (game->current_level > game->total_levels)
+    {
+        level_end(game, 'Q');
+    }
+
+    if (game->level_over)
+    {
+        return;
+    }
+
+    if (!game->room_loaded)
+    {
+        FILE *stream = fopen(current_room, "r");
+        if (stream != NULL)
+        {
+            load_room(game, stream);
+            fclose(stream);
+        }
+    }
+
+    game->game_time = game_clock_ns(game->game_clock) - game->start_time;
+
+    // Stop early if a step ends the level, as the next room has not been loaded yet.
+    for (int i = 0; i < steps && game->room_loaded && !game->level_over; i++)
+    {
+        update_world(game);
+    }
+}
+
+/////////////////GAMEPLAY FUNCTIONS/////////////////
+////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////
+//////////////////SETUP FUNCTIONS///////////////////
+
+GameState *new_game(int width, int height, int total_levels, uint64_t seed, const AiParams *ai)
+{
+    GameState *game = calloc(1, sizeof(GameState));
+
+    rng_seed(&game->rng, seed);
+    game->ai = *ai;
+    game->width = width;
+    game->height = height;
+    game->total_levels = total_levels;
+    game->current_level = 1;
+
+    setup_timers(game);
+    setup(game);
+    game->jerry.points = 0;
+    game->tom.points = 0;
+    game->jerry.lives = LIVES;
+    game->tom.lives = LIVES;
+
+    return game;
+}
+
+void setup_timers(GameState *game)
+{
+    game->game_clock = create_game_clock();
+    game->game_timers = create_timer_wheel(DELAY);
+    game->cheese_timer = create_wheel_timer(game->game_timers, CHEESE_INTERVAL, spawn_cheese, game);
+    game->trap_timer = create_wheel_timer(game->game_timers, TRAP_INTERVAL, spawn_trap, game);
+    game->firework_timer = create_wheel_timer(game->game_timers, FIREWORK_INTERVAL, launch_firework, game);
+}
+
+void setup(GameState *game)
+{
+    game->start_time = game_clock_ns(game->game_clock);
+    game_clock_resume(game->game_clock);
+
+    game->game_over = false;
+    game->level_over = false;
+    game->pause = false;
+    game->room_loaded = false;
+    game->room_drawn = false;
+    game->game_over_drawn = false;
+
+    game->current_player = 'J';
+    game->setup_players = 0;
+
+    game->jerry.speed = rng_unit(&game->rng) * game->ai.min_speed + game->ai.min_speed;
+    game->jerry.direction = rng_unit(&game->rng) * M_PI * 2;
+
+    game->tom.speed = rng_unit(&game->rng) * game->ai.min_speed + game->ai.min_speed;
+    game->tom.direction = rng_unit(&game->rng) * M_PI * 2;
+    game->tom.level_points = 0;
+
+    game->firework.xpos = -1;
+    game->firework.ypos = -1;
+    game->firework.symbol = '~';
+
+    game->cheese = 0;
+    game->cheese_collected = 0;
+    game->traps = 0;
+    game->trap_supply = 5;
+    game->fireworks = 0;
+
+    int reset_objs[5][2] = {{-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}};
+    memcpy(game->cheese_positions, reset_objs, sizeof(reset_objs));
+    memcpy(game->trap_positions, reset_objs, sizeof(reset_objs));
+
+    int reset_door[2] = {-1, 1};
+    memcpy(game->door_position, reset_door, sizeof(reset_door));
+
+    timer_reset(game->cheese_timer);
+    timer_reset(game->trap_timer);
+    timer_reset(game->firework_timer);
+}
+
+void free_game(GameState *game)
+{
+    destroy_timer(game->cheese_timer);
+    destroy_timer(game->trap_timer);
+    destroy_timer(game->firework_timer);
+    destroy_timer_wheel(game->game_timers);
+    destroy_game_clock(game->game_clock);
+
+    flow_field_free(&game->jerry_flow);
+    flow_field_free(&game->tom_flow);
+    distance_map_free(&game->cheese_map);
+    distance_map_free(&game->door_map);
+    distance_map_free(&game->tom_map);
+    distance_map_free(&game->trap_map);
+    path_hierarchy_free(&game->room_hierarchy);
+
+    free(game->room_paths.cost);
+    free(game->jerry_paths.cost);
+    free(game->jerry_influence);
+    free(game->room_grid);
+    free(game);
+}
+
+//////////////////SETUP FUNCTIONS///////////////////
+////////////////////////////////////////////////////
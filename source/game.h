@@ -0,0 +1,288 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <cab202_timers.h>
+#include "pathfind.h"
+#include "rng.h"
+
+#define DELAY 10
+#define TICK ((int64_t)DELAY * NANOSECONDS / MILLISECONDS)
+#define HEIGHT(game) (double)(game)->height
+#define WIDTH(game) (double)(game)->width
+#define MINSPEED 0.1
+#define CHASE_SPEED 0.08
+#define JERRY_SPEED 0.1
+#define WALL '*'
+#define CHEESE_INTERVAL 2000
+#define TRAP_INTERVAL 3000
+#define FIREWORK_INTERVAL 5000
+#define FLOW_BUDGET 4096
+#define PATH_CLUSTER 10
+#define FIREWORK_SPEED 0.2
+#define FIREWORK_TURN (M_PI / 8)
+#define CHEESE_RANGE 10
+#define DOOR_RANGE 30
+#define TOM_RANGE 6
+#define TRAP_RANGE 2
+#define TRAP_COST 8
+#define LIVES 5
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+struct player
+{
+    int points, lives, level_points;
+    double initx, inity, xpos, ypos, speed, direction;
+    char symbol;
+    int colour;
+};
+
+// Constants governing the automated players, by default MINSPEED, CHASE_SPEED and so on. Each game has its own, so
+// tomjerry-sweep can vary them from game to game.
+typedef struct
+{
+    // Speeds in cells per step: wandering players move at between min_speed and twice that, Tom chases at chase_speed,
+    // automated Jerry follows the influence map at jerry_speed and fireworks fly at firework_speed.
+    double min_speed, chase_speed, jerry_speed, firework_speed;
+
+    // Ranges in cells over which cheese, the door, Tom and traps influence automated Jerry.
+    int cheese_range, door_range, tom_range, trap_range;
+} AiParams;
+
+// The default constants of the automated players.
+extern const AiParams default_ai;
+
+// Everything one game plays with, so a process can run any number of independent games side by side.
+// Every function below takes the game it acts on as its first argument, or as the context of a timer. Only the drawing
+// functions use the ZDK screen; the rest see the play area as width x height, which is the screen size when the game is shown.
+typedef struct
+{
+    bool game_over, level_over, pause, room_loaded, room_drawn, game_over_drawn;
+
+    int setup_players, total_levels;
+    int cheese, cheese_collected, traps, trap_supply, fireworks, current_level, current_player;
+    int cheese_positions[5][2], trap_positions[5][2], door_position[2];
+    int width, height;
+    int grid_width, grid_height;
+    char *room_grid;
+    PathGrid room_paths, jerry_paths;
+    FlowField jerry_flow, tom_flow;
+    DistanceMap cheese_map, door_map, tom_map, trap_map;
+    double *jerry_influence;
+    int tom_source[2];
+    PathHierarchy room_hierarchy;
+    Rng rng;
+    int64_t game_time, start_time;
+    game_clock_id game_clock;
+    timer_wheel_id game_timers;
+    timer_id cheese_timer, trap_timer, firework_timer;
+    struct player jerry, tom, firework;
+    AiParams ai;
+
+    // Both sides are automated, as in tomjerry-sim: the player's side moves as automated Jerry does (see update_autoplay).
+    bool autoplay;
+
+    // The game clock runs on virtual time, stepping as fast as the game can be computed rather than in real time,
+    // for watching a game play itself (see the main loop in tomjerry.c).
+    bool fast_forward;
+} GameState;
+
+/////////////////////////////////////////////////////
+////////////////FUNC DECLARATIONS////////////////////
+
+/*//////////////*/
+/*Gameplay Funcs*/
+
+// Read the room from a specified FILE pointer, placing Tom and Jerry and recording every wall in the collision grid.
+void load_room(GameState *game, FILE *stream);
+
+// Mark a single cell of the collision grid as a wall. Passed to trace_line() so the grid matches what draw_line() displays.
+void plot_wall(int x, int y, void *data);
+
+// Rebuild the pathfinding grid from the collision grid: walls and the status bar are blocked, every other cell costs 1.
+// Also rebuilds the hierarchy of PATH_CLUSTER sized clusters over it, and the distance maps and influence map which guide automated Jerry.
+void build_path_grid(GameState *game);
+
+// Returns the symbol at (x, y) as it would appear on screen: walls from the collision grid, with players and objects on top.
+// Returns -1 off screen and '-' in the status bar. The object whose symbol is ignore is skipped, so an object never collides with itself.
+char cell_at(GameState *game, int x, int y, char ignore);
+
+// After any point is scored, check_win is called to see if 5 cheese have been collected by Jerry, or Tom has scored 5 points. If so, spawn the Door at a random position drawn from the game's rng.
+void check_win(GameState *game);
+
+// Checks is the firework has collided with Tom and handles point calculations. If it hasn't then go to firework_homing to move closer to Tom.
+void update_firework(GameState *game);
+
+// After checking collisions in update_firework(), firework_homing is called to advance the firework's position closer to Tom.
+// The firework steers along the flow field towards Tom, turning at most FIREWORK_TURN radians per step, and is destroyed if it flies into a wall.
+void firework_homing(GameState *game);
+
+// Returns the heading from the firework to the centre of the next cell of the flow field towards Tom, or straight at Tom when
+// it is in his cell or the field has no step from its cell.
+double firework_heading(GameState *game);
+
+// Launch a firework from Jerry's position, already heading along its path to Tom.
+void shoot_firework(GameState *game);
+
+// Check the value of key_pressed; if it is a directional value (WASD) then move the current player.
+// If it is an action value, then shoot a firework, place a trap etc.
+void update_movement(GameState *game, int key_pressed, struct player *plyr);
+
+// Check both cheese and trap collisions at once and perform actions based on the current player.
+void check_cheese_trap_collisions(GameState *game);
+
+// Check the associated collisions with Jerry as a player. i.e. if he collides with cheese, add 1 to his points.
+void check_jerry_collisions(GameState *game);
+
+// Check the associated collisions with Tom as a player. i.e. if he collides with a firework, take 1 away from Tom's lives.
+void check_tom_collisions(GameState *game);
+
+// Update the movement of the current player, as well as check for associated collisions. Parse in the key pressed, and a pointer to the current player.
+void update_player(GameState *game, int key_pressed, struct player *plyr);
+
+// Updates Tom's random movement by calling move_random();
+void update_tom(GameState *game);
+
+// Move the input player (via reference) randomly around the screen,
+// changing speed and direction, drawn from the game's rng, every time it collides with a wall.
+void move_random(GameState *game, struct player *plyr);
+
+// Move the player automatically with a dx and dy, checking for wall collisions.
+void move_auto_player(GameState *game, struct player *plyr, double dx, double dy);
+
+// Move Tom along the flow field towards Jerry with move_auto_player. This function controls Toms "seeking" behaviour.
+// Until the first flow field is complete, which takes several steps on a large screen, follows the room's hierarchy instead.
+// Heads straight for Jerry when already in his cell, or when there is no path.
+void update_tom_advanced(GameState *game);
+
+// Point the flow field towards Jerry's cell when he moves to another one, and continue rebuilding it, at most FLOW_BUDGET cells per step.
+// Every chaser reads its next step from the same field, so the cost per chaser is constant. The field is left alone while
+// nothing chases Jerry along it: on level 1, where Tom moves randomly, and while Tom is the player.
+// While a firework is live, does the same for the field towards Tom which fireworks steer by.
+// Each move of a target to another cell costs a full rebuild of its field (see FlowField), which dominates the time of a
+// game past level 1.
+void update_flow_fields(GameState *game);
+
+// Move the player (via reference) towards (x, y) at the given speed with move_auto_player. Does nothing if it is already there.
+void move_towards(GameState *game, struct player *plyr, double x, double y, double speed);
+
+// Move the player (via reference) one step along a flow field: towards the centre of the neighbouring cell it points to, at the given speed.
+// Returns false without moving if the field has no step from the player's cell.
+bool follow_flow_field(GameState *game, struct player *plyr, const FlowField *field, double speed);
+
+// Move the player (via reference) one step along a hierarchical path to (x, y), refining only the leg to its first waypoint.
+// Returns false without moving if there is no path, or the player is already in that cell.
+bool follow_hierarchy(GameState *game, struct player *plyr, PathHierarchy *hierarchy, int x, int y, double speed);
+
+// Returns the influence of cell i on automated Jerry: attraction to cheese and the door, less the danger of Tom and traps.
+// Each term is largest at its source and fades to nothing over the range of its distance map, measured along walkable paths.
+double influence_at(GameState *game, int i);
+
+// Recompute the influence of every cell whose distance in map was changed by its most recent change of sources.
+void refresh_influence(GameState *game, const DistanceMap *map);
+
+// Returns the grid that distances in one of the distance maps behind the influence map are measured on.
+// Cheese and the door are sought on jerry_paths, which steers around traps; Tom and traps are measured on room_paths.
+const PathGrid *influence_grid(GameState *game, const DistanceMap *map);
+
+// Add a source at (x, y) to one of the distance maps behind the influence map, and refresh the influence of the cells it changes.
+void add_influence(GameState *game, DistanceMap *map, int x, int y);
+
+// Remove a source at (x, y) from one of the distance maps behind the influence map, and refresh the influence of the cells it changes.
+void remove_influence(GameState *game, DistanceMap *map, int x, int y);
+
+// Set the cost of cell (x, y) on jerry_paths, and repair the distances to cheese and the door across it, rather than
+// rebuilding their maps. Used as traps are placed and removed.
+void set_trap_cost(GameState *game, int x, int y, int cost);
+
+// Move the source of Tom's danger to his cell when he moves to another one.
+void update_tom_influence(GameState *game);
+
+// Move automated Jerry towards whichever neighbouring cell has the highest influence, sampling the influence map once per
+// candidate step. If none is higher than his own cell, Jerry moves randomly instead.
+void follow_influence(GameState *game);
+
+// Remove the cheese at index i in the cheese_positions array from the room and from the influence map.
+void collect_cheese(GameState *game, int i);
+
+// Remove the trap at index i in the trap_positions array from the room and from the influence map.
+void remove_trap(GameState *game, int i);
+
+// Update automated Jerry: move him along the influence map, and check his cheese and trap collisions.
+void update_jerry(GameState *game);
+
+// Update the "enemy" player i.e. the current automated player.
+void update_enemy(GameState *game);
+
+// Checks collisions relative to current player's x and y displacement, with specified symbol.
+int check_collision(GameState *game, struct player plyr, char symbol, double xd, double yd);
+
+// Handle loss of life events.
+void lose_life(GameState *game);
+
+// Timer callback: place a cheese at a random position every CHEESE_INTERVAL milliseconds, unless there are already 5.
+void spawn_cheese(void *context);
+
+// Timer callback: place a trap at Tom's position every TRAP_INTERVAL milliseconds. Only places a trap automatically when Tom is NOT the player.
+void spawn_trap(void *context);
+
+// Timer callback: automated Jerry, or Jerry in a game which plays itself after level 1, shoots a firework every FIREWORK_INTERVAL milliseconds.
+void launch_firework(void *context);
+
+// Place a trap at Tom's x and y position.
+void place_trap(GameState *game);
+
+// Place a cheese at either a random position on the screen drawn from the game's rng (auto_place == 'A') or at Tom's position (auto_place == 'M').
+void place_cheese(GameState *game, char auto_place);
+
+// Handle the end of the level, either by death or reaching the door.
+// Condition 'Q' goes to game over screen, stopping the game clock so the game sleeps until a key is pressed.
+// Condition 'N' goes to the next level.
+void level_end(GameState *game, char condition);
+
+// Toggle the pause state, stopping or restarting the game clock.
+void paused(GameState *game);
+
+// Advance the automated parts of the game by one fixed timestep of DELAY milliseconds of game time: flow fields, fireworks, the enemy player,
+// and the timers which place cheese and traps and launch fireworks. Also moves the player's side when the game plays itself.
+void update_world(GameState *game);
+
+// Move Jerry as the player's side of a game which plays itself: along the influence map like automated Jerry, checking his
+// collisions as a player's, so cheese, the door and Tom score and end levels as they do for a person playing Jerry.
+void update_autoplay(GameState *game);
+
+// Load the room of the current level from the file current_room if it has not been loaded yet, and advance the world by steps
+// fixed timesteps, stopping early if the level ends. Ends the game once the last level has been passed.
+void advance_game(GameState *game, char *current_room, int steps);
+
+/*Gameplay Funcs*/
+/*//////////////*/
+
+/*Setup Funcs*/
+/*///////////*/
+
+// Allocate a game with a play area of width x height cells and total_levels levels, its random numbers seeded with seed
+// and its automated players governed by ai, ready to load its first room.
+GameState *new_game(int width, int height, int total_levels, uint64_t seed, const AiParams *ai);
+
+// Create the game clock, and the timer wheel which drives cheese and trap placement and automated fireworks, one tick per fixed timestep.
+void setup_timers(GameState *game);
+
+// Reset all variable back to initial values, including game time, points, lives etc.
+void setup(GameState *game);
+
+// Release the room, pathfinding data, clock and timers held by the game, and the game itself.
+void free_game(GameState *game);
+
+/*Setup Funcs*/
+/*///////////*/
+
+////////////////FUNC DECLARATIONS////////////////////
+/////////////////////////////////////////////////////
+
+#endif
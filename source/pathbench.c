@@ -0,0 +1,419 @@
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <cab202_graphics.h>
+#include <cab202_timers.h>
+#include "pathfind.h"
+
+// Benchmark of the pathfinding modes in pathfind.c. Every room given on the command line is loaded at the default
+// terminal size and at 4 times that size, and large rooms are generated from random wall segments. On each map the same
+// random queries are answered with every mode, comparing the cost of the paths found with the cheapest, found by A*.
+// Then a distance map to several sources is repaired after random cells change cost, and compared with rebuilding it, both
+// in speed and in the distances and first steps of every cell. Exits with status 1 if any repaired map differs.
+//
+// Usage: pathbench [room files...], for example: ./pathbench ../bin/room*.txt
+
+#define QUERIES 200
+#define MAX_PATH 1000000
+#define STATUS_ROWS 5
+#define CLUSTER_SIZE 16
+#define REPAIRS 200
+#define REPAIR_SOURCES 8
+#define REPAIR_COST 8
+#define REPAIR_CHECK 20
+
+// Size of a terminal the rooms are drawn on.
+#define ROOM_WIDTH 100
+#define ROOM_HEIGHT 30
+
+/////////////////////////////////////////////////////
+////////////////FUNC DECLARATIONS////////////////////
+
+// Allocate a grid of the given size, with the status bar rows blocked and every other cell open.
+PathGrid new_grid(int width, int height);
+
+// Block a single cell of the grid. Passed to trace_line() so walls match what the game draws.
+void plot_blocked(int x, int y, void *data);
+
+// Read a room file onto a grid of the given size, mapping coordinates the same way as load_room() in tomjerry.c.
+// Returns false if the file cannot be opened.
+bool load_grid(const char *file_name, int width, int height, PathGrid *grid);
+
+// Generate a room of the given size with random wall segments of up to max_length cells.
+PathGrid generate_grid(int width, int height, int walls, int max_length);
+
+// Sum of the step costs along a path, as returned by path_find().
+int path_cost(const PathGrid *grid, int start, const int *path, int length);
+
+// Answer a query from start to goal in the given way. Adds the number of nodes expanded to expanded, and returns the cost
+// of the path found, -1 if there is none, or 0 if only the first leg was refined.
+int query(int mode, PathArena *arena, PathHierarchy *hierarchy, const PathGrid *grid, const int start[2], const int goal[2], long *expanded);
+
+// Answer the same random queries on grid with each mode and print the average nodes expanded and time per query, and how
+// much dearer the paths found are than the cheapest.
+void benchmark(const char *name, const PathGrid *grid);
+
+// Change the cost of random open cells of a copy of grid between 1 and REPAIR_COST, like traps being placed and removed, and
+// print the average cells touched and time taken to repair a distance map after each change, and to rebuild it instead.
+// Returns the number of cells whose repaired distance or first step was found wrong, checking every REPAIR_CHECK changes.
+int benchmark_repair(const char *name, const PathGrid *grid);
+
+// Returns the number of cells of map whose distance differs from that in rebuilt, or whose first step does not lead to a
+// neighbour it can step to with a distance less by exactly the cost of the step.
+int check_repair(const DistanceMap *map, const DistanceMap *rebuilt, const PathGrid *grid);
+
+////////////////FUNC DECLARATIONS////////////////////
+/////////////////////////////////////////////////////
+
+// Ways of answering a query: each mode of path_find(), then a hierarchical query refined into cells all the way to the goal,
+// and one refined only as far as its first waypoint, which is all an agent replanning every step has to do.
+enum
+{
+    BENCH_HIERARCHY = PATH_JPS + 1,
+    BENCH_HIERARCHY_FIRST,
+    BENCH_MODES
+};
+
+PathGrid new_grid(int width, int height)
+{
+    PathGrid grid = {width, height, malloc(width * height)};
+
+    for (int i = 0; i < width * height; i++)
+    {
+        grid.cost[i] = i < STATUS_ROWS * width ? 0 : 1;
+    }
+
+    return grid;
+}
+
+void plot_blocked(int x, int y, void *data)
+{
+    PathGrid *grid = data;
+
+    if (x >= 0 && x < grid->width && y >= 0 && y < grid->height)
+    {
+        grid->cost[y * grid->width + x] = 0;
+    }
+}
+
+bool load_grid(const char *file_name, int width, int height, PathGrid *grid)
+{
+    FILE *stream = fopen(file_name, "r");
+    if (stream == NULL)
+    {
+        return false;
+    }
+
+    *grid = new_grid(width, height);
+
+    while (!feof(stream))
+    {
+        char command;
+        double x1, y1, x2, y2;
+
+        if (fscanf(stream, "%c %lf %lf %lf %lf", &command, &x1, &y1, &x2, &y2) == 5 && command == 'W')
+        {
+            trace_line(round(x1 * width), round(y1 * height + 4), round(x2 * width), round(y2 * height + 4), plot_blocked, grid);
+        }
+    }
+
+    fclose(stream);
+    return true;
+}
+
+PathGrid generate_grid(int width, int height, int walls, int max_length)
+{
+    PathGrid grid = new_grid(width, height);
+
+    for (int i = 0; i < walls; i++)
+    {
+        int x = rand() % width;
+        int y = STATUS_ROWS + rand() % (height - STATUS_ROWS);
+        int length = rand() % max_length;
+
+        if (rand() % 2)
+        {
+            trace_line(x, y, x + length, y, plot_blocked, &grid);
+        }
+        else
+        {
+            trace_line(x, y, x, y + length, plot_blocked, &grid);
+        }
+    }
+
+    return grid;
+}
+
+int path_cost(const PathGrid *grid, int start, const int *path, int length)
+{
+    int cost = 0;
+    int previous = start;
+
+    for (int i = 0; i < length; i++)
+    {
+        bool diagonal = path[i] % grid->width != previous % grid->width && path[i] / grid->width != previous / grid->width;
+        cost += (diagonal ? PATH_DIAGONAL_COST : PATH_STRAIGHT_COST) * grid->cost[path[i]];
+        previous = path[i];
+    }
+
+    return cost;
+}
+
+int query(int mode, PathArena *arena, PathHierarchy *hierarchy, const PathGrid *grid, const int start[2], const int goal[2], long *expanded)
+{
+    static int path[MAX_PATH], waypoints[MAX_PATH];
+    int length;
+
+    if (mode == PATH_ASTAR || mode == PATH_JPS)
+    {
+        length = path_find(arena, grid, mode, start[0], start[1], goal[0], goal[1], path, MAX_PATH);
+        *expanded += arena->expanded;
+        return length < 0 ? -1 : path_cost(grid, start[1] * grid->width + start[0], path, length);
+    }
+
+    int count = path_hierarchy_find(hierarchy, grid, start[0], start[1], goal[0], goal[1], waypoints, MAX_PATH);
+    *expanded += hierarchy->expanded;
+
+    if (count < 0)
+    {
+        return -1;
+    }
+
+    int cost = 0;
+    int from = start[1] * grid->width + start[0];
+
+    for (int i = 0; i < count && (i == 0 || mode == BENCH_HIERARCHY); i++)
+    {
+        length = path_hierarchy_refine(hierarchy, grid, from % grid->width, from / grid->width, waypoints[i] % grid->width, waypoints[i] / grid->width, path, MAX_PATH);
+        *expanded += hierarchy->expanded;
+        cost += path_cost(grid, from, path, length);
+        from = waypoints[i];
+    }
+
+    return mode == BENCH_HIERARCHY ? cost : 0;
+}
+
+void benchmark(const char *name, const PathGrid *grid)
+{
+    static const char *mode_names[] = {"A*", "JPS", "HPA*", "HPA*1"};
+    int starts[QUERIES][2], goals[QUERIES][2], costs[QUERIES];
+    int queries = 0;
+
+    while (queries < QUERIES)
+    {
+        int x1 = rand() % grid->width, y1 = rand() % grid->height;
+        int x2 = rand() % grid->width, y2 = rand() % grid->height;
+
+        if (path_walkable(grid, x1, y1) && path_walkable(grid, x2, y2))
+        {
+            starts[queries][0] = x1;
+            starts[queries][1] = y1;
+            goals[queries][0] = x2;
+            goals[queries][1] = y2;
+            queries++;
+        }
+    }
+
+    PathArena arena = {0};
+    PathHierarchy hierarchy = {0};
+
+    path_arena_reserve(&arena, grid->width * grid->height);
+    int64_t build_time = get_monotonic_ns();
+    path_hierarchy_build(&hierarchy, grid, CLUSTER_SIZE);
+    build_time = get_monotonic_ns() - build_time;
+
+    for (int mode = PATH_ASTAR; mode < BENCH_MODES; mode++)
+    {
+        long expanded = 0;
+        int found = 0, compared = 0;
+        double excess = 0;
+        int64_t start_time = get_monotonic_ns();
+
+        for (int i = 0; i < queries; i++)
+        {
+            int cost = query(mode, &arena, &hierarchy, grid, starts[i], goals[i], &expanded);
+
+            found += cost >= 0;
+
+            if (mode == PATH_ASTAR)
+            {
+                costs[i] = cost;
+            }
+            else if (mode != BENCH_HIERARCHY_FIRST && cost > 0 && costs[i] > 0)
+            {
+                excess += 100.0 * (cost - costs[i]) / costs[i];
+                compared++;
+            }
+        }
+
+        double microseconds = (double)(get_monotonic_ns() - start_time) / queries / (NANOSECONDS / 1000000);
+
+        printf("%-22s %4dx%-5d %-5s %7d/%-4d %12.1f %12.1f", name, grid->width, grid->height, mode_names[mode], found, queries, (double)expanded / queries, microseconds);
+        if (compared > 0)
+        {
+            printf(" %9.2f%%\n", excess / compared);
+        }
+        else
+        {
+            printf(" %10s\n", "-");
+        }
+    }
+
+    printf("%-22s %d nodes, %d edges, built in %.1f ms\n", "", hierarchy.node_count, hierarchy.edge_start[hierarchy.node_count], (double)build_time / (NANOSECONDS / MILLISECONDS));
+
+    path_arena_free(&arena);
+    path_hierarchy_free(&hierarchy);
+}
+
+int check_repair(const DistanceMap *map, const DistanceMap *rebuilt, const PathGrid *grid)
+{
+    int wrong = 0;
+
+    for (int y = 0; y < grid->height; y++)
+    {
+        for (int x = 0; x < grid->width; x++)
+        {
+            int distance = distance_map_distance(map, x, y);
+            int dx, dy;
+            bool step = distance_map_step(map, x, y, &dx, &dy);
+
+            if (distance != distance_map_distance(rebuilt, x, y))
+            {
+                wrong++;
+            }
+            else if (!step)
+            {
+                // Only sources, with nothing nearer, and unreached cells have no step.
+                wrong += distance > 0;
+            }
+            else
+            {
+                int next = (y + dy) * grid->width + x + dx;
+                int cost = ((dx != 0 && dy != 0) ? PATH_DIAGONAL_COST : PATH_STRAIGHT_COST) * grid->cost[next];
+
+                wrong += !path_can_step(grid, x, y, dx, dy) || distance != distance_map_distance(map, x + dx, y + dy) + cost;
+            }
+        }
+    }
+
+    return wrong;
+}
+
+int benchmark_repair(const char *name, const PathGrid *grid)
+{
+    PathGrid copy = {grid->width, grid->height, malloc(grid->width * grid->height)};
+    DistanceMap map = {0}, rebuilt = {0};
+    int sources[REPAIR_SOURCES][2];
+
+    memcpy(copy.cost, grid->cost, grid->width * grid->height);
+    distance_map_reset(&map, &copy, 0);
+
+    for (int i = 0; i < REPAIR_SOURCES;)
+    {
+        sources[i][0] = rand() % copy.width;
+        sources[i][1] = rand() % copy.height;
+
+        if (path_walkable(&copy, sources[i][0], sources[i][1]))
+        {
+            distance_map_add_source(&map, &copy, sources[i][0], sources[i][1]);
+            i++;
+        }
+    }
+
+    long repair_touched = 0, rebuild_touched = 0;
+    int64_t repair_time = 0, rebuild_time = 0;
+    int wrong = 0;
+
+    for (int i = 0; i < REPAIRS;)
+    {
+        int x = rand() % copy.width, y = rand() % copy.height;
+
+        if (!path_walkable(&copy, x, y))
+        {
+            continue;
+        }
+
+        int old_cost = copy.cost[y * copy.width + x];
+        copy.cost[y * copy.width + x] = old_cost == 1 ? REPAIR_COST : 1;
+
+        int64_t start_time = get_monotonic_ns();
+        distance_map_update_cell(&map, &copy, x, y, old_cost);
+        repair_time += get_monotonic_ns() - start_time;
+        repair_touched += map.touched;
+
+        // Rebuilding is only done after some changes, as it costs as much as the rest of the benchmark put together.
+        if (i % REPAIR_CHECK == REPAIR_CHECK - 1)
+        {
+            start_time = get_monotonic_ns();
+            distance_map_reset(&rebuilt, &copy, 0);
+            for (int j = 0; j < REPAIR_SOURCES; j++)
+            {
+                distance_map_add_source(&rebuilt, &copy, sources[j][0], sources[j][1]);
+                rebuild_touched += rebuilt.touched;
+            }
+            rebuild_time += get_monotonic_ns() - start_time;
+
+            wrong += check_repair(&map, &rebuilt, &copy);
+        }
+
+        i++;
+    }
+
+    double rebuilds = REPAIRS / REPAIR_CHECK;
+    double microseconds = NANOSECONDS / 1000000;
+
+    printf("%-22s repair: %.1f cells in %.1f us, rebuild: %.1f cells in %.1f us, %d cells wrong\n\n", "",
+           (double)repair_touched / REPAIRS, repair_time / microseconds / REPAIRS, rebuild_touched / rebuilds, rebuild_time / microseconds / rebuilds, wrong);
+
+    distance_map_free(&map);
+    distance_map_free(&rebuilt);
+    free(copy.cost);
+    return wrong;
+}
+
+int main(int argc, char *argv[])
+{
+    int wrong = 0;
+
+    srand(202);
+
+    printf("%-22s %-10s %-5s %12s %12s %12s %10s\n", "map", "size", "mode", "found", "expanded", "us/query", "excess");
+
+    for (int i = 1; i < argc; i++)
+    {
+        for (int scale = 1; scale <= 4; scale *= 4)
+        {
+            PathGrid grid;
+            if (!load_grid(argv[i], ROOM_WIDTH * scale, ROOM_HEIGHT * scale, &grid))
+            {
+                fprintf(stderr, "pathbench: cannot open %s\n", argv[i]);
+                return 1;
+            }
+            const char *name = strrchr(argv[i], '/');
+            benchmark(name == NULL ? argv[i] : name + 1, &grid);
+            wrong += benchmark_repair(name == NULL ? argv[i] : name + 1, &grid);
+            free(grid.cost);
+        }
+    }
+
+    int sizes[] = {256, 512, 1024};
+    for (int i = 0; i < 3; i++)
+    {
+        PathGrid grid = generate_grid(sizes[i], sizes[i], sizes[i] / 2, sizes[i] / 8);
+        char name[32];
+        snprintf(name, sizeof(name), "generated-%d", sizes[i]);
+        benchmark(name, &grid);
+        wrong += benchmark_repair(name, &grid);
+        free(grid.cost);
+    }
+
+    if (wrong > 0)
+    {
+        fprintf(stderr, "pathbench: %d cells of repaired distance maps differ from rebuilt maps\n", wrong);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,1340 @@
+#include <stdlib.h>
+#include "pathfind.h"
+
+// Border runs of open cells shorter than this get one entrance in the middle, longer runs one at each end.
+#define ENTRANCE_SPLIT 6
+
+// Offsets of the 8 neighbours of a cell: the 4 straight ones first, then the 4 diagonals.
+// Opposite directions are paired, so the reverse of direction i is direction (i ^ 1).
+static const int neighbour_dx[8] = {1, -1, 0, 0, 1, -1, 1, -1};
+static const int neighbour_dy[8] = {0, 0, 1, -1, 1, -1, -1, 1};
+
+void path_arena_reserve(PathArena *arena, int cells)
+{
+    if (cells <= arena->capacity)
+    {
+        return;
+    }
+
+    arena->stamp = realloc(arena->stamp, cells * sizeof(unsigned int));
+    arena->g = realloc(arena->g, cells * sizeof(int));
+    arena->f = realloc(arena->f, cells * sizeof(int));
+    arena->parent = realloc(arena->parent, cells * sizeof(int));
+    arena->heap = realloc(arena->heap, cells * sizeof(int));
+    arena->heap_index = realloc(arena->heap_index, cells * sizeof(int));
+
+    // New stamps must not match any search, old or new.
+    for (int i = 0; i < cells; i++)
+    {
+        arena->stamp[i] = 0;
+    }
+    arena->search = 0;
+    arena->capacity = cells;
+}
+
+void path_arena_free(PathArena *arena)
+{
+    free(arena->stamp);
+    free(arena->g);
+    free(arena->f);
+    free(arena->parent);
+    free(arena->heap);
+    free(arena->heap_index);
+    *arena = (PathArena){0};
+}
+
+bool path_walkable(const PathGrid *grid, int x, int y)
+{
+    return x >= 0 && y >= 0 && x < grid->width && y < grid->height && grid->cost[y * grid->width + x] != 0;
+}
+
+bool path_can_step(const PathGrid *grid, int x, int y, int dx, int dy)
+{
+    if (!path_walkable(grid, x + dx, y + dy))
+    {
+        return false;
+    }
+
+    if (dx != 0 && dy != 0)
+    {
+        return path_walkable(grid, x + dx, y) && path_walkable(grid, x, y + dy);
+    }
+
+    return true;
+}
+
+int path_heuristic(int x1, int y1, int x2, int y2)
+{
+    int dx = abs(x1 - x2);
+    int dy = abs(y1 - y2);
+    int diagonal = dx < dy ? dx : dy;
+
+    return PATH_STRAIGHT_COST * (dx + dy) + (PATH_DIAGONAL_COST - 2 * PATH_STRAIGHT_COST) * diagonal;
+}
+
+// Binary heap of open nodes, ordered by f. heap_index records each node's position in the heap so its key can be decreased in place.
+
+static bool heap_less(const PathArena *arena, int a, int b)
+{
+    // On equal f, prefer the node further from the start, which is closer to the goal.
+    return arena->f[a] < arena->f[b] || (arena->f[a] == arena->f[b] && arena->g[a] > arena->g[b]);
+}
+
+static void heap_place(PathArena *arena, int position, int node)
+{
+    arena->heap[position] = node;
+    arena->heap_index[node] = position;
+}
+
+static void heap_sift_up(PathArena *arena, int position)
+{
+    int node = arena->heap[position];
+
+    while (position > 0)
+    {
+        int parent = (position - 1) / 2;
+        if (!heap_less(arena, node, arena->heap[parent]))
+        {
+            break;
+        }
+        heap_place(arena, position, arena->heap[parent]);
+        position = parent;
+    }
+
+    heap_place(arena, position, node);
+}
+
+static void heap_sift_down(PathArena *arena, int position)
+{
+    int node = arena->heap[position];
+
+    while (true)
+    {
+        int child = 2 * position + 1;
+        if (child >= arena->heap_size)
+        {
+            break;
+        }
+        if (child + 1 < arena->heap_size && heap_less(arena, arena->heap[child + 1], arena->heap[child]))
+        {
+            child++;
+        }
+        if (!heap_less(arena, arena->heap[child], node))
+        {
+            break;
+        }
+        heap_place(arena, position, arena->heap[child]);
+        position = child;
+    }
+
+    heap_place(arena, position, node);
+}
+
+static void heap_push(PathArena *arena, int node)
+{
+    heap_place(arena, arena->heap_size, node);
+    arena->heap_size++;
+    heap_sift_up(arena, arena->heap_size - 1);
+}
+
+static int heap_pop(PathArena *arena)
+{
+    int node = arena->heap[0];
+    arena->heap_size--;
+
+    if (arena->heap_size > 0)
+    {
+        heap_place(arena, 0, arena->heap[arena->heap_size]);
+        heap_sift_down(arena, 0);
+    }
+
+    // Closed nodes are marked with a heap index of -1.
+    arena->heap_index[node] = -1;
+    return node;
+}
+
+// Start a new search over nodes nodes, so that every node reads as unreached.
+static void begin_search(PathArena *arena, int nodes)
+{
+    path_arena_reserve(arena, nodes);
+
+    arena->search++;
+    if (arena->search == 0)
+    {
+        // The stamp has wrapped around, so old stamps could match again.
+        for (int i = 0; i < arena->capacity; i++)
+        {
+            arena->stamp[i] = 0;
+        }
+        arena->search = 1;
+    }
+
+    arena->heap_size = 0;
+    arena->expanded = 0;
+}
+
+// Reach node with cost g through parent, opening it or improving its cost if it is still open.
+static void relax(PathArena *arena, int node, int g, int h, int parent)
+{
+    if (arena->stamp[node] != arena->search)
+    {
+        arena->stamp[node] = arena->search;
+        arena->g[node] = g;
+        arena->f[node] = g + h;
+        arena->parent[node] = parent;
+        heap_push(arena, node);
+    }
+    else if (arena->heap_index[node] != -1 && g < arena->g[node])
+    {
+        arena->f[node] -= arena->g[node] - g;
+        arena->g[node] = g;
+        arena->parent[node] = parent;
+        heap_sift_up(arena, arena->heap_index[node]);
+    }
+}
+
+static int sign(int value)
+{
+    return (value > 0) - (value < 0);
+}
+
+// Write the path ending at goal into path, following parent links back to start.
+// Parent links may span several cells along a straight or diagonal line, as they do in Jump Point Search, and are filled in cell by cell.
+static int trace_path(const PathArena *arena, int width, int start, int goal, int *path, int max_length)
+{
+    int length = 0;
+    for (int node = goal; node != start; node = arena->parent[node])
+    {
+        int parent = arena->parent[node];
+        int dx = abs(node % width - parent % width);
+        int dy = abs(node / width - parent / width);
+        length += dx > dy ? dx : dy;
+    }
+
+    int position = length;
+    for (int node = goal; node != start; node = arena->parent[node])
+    {
+        int parent = arena->parent[node];
+        int step = sign(parent / width - node / width) * width + sign(parent % width - node % width);
+
+        for (int cell = node; cell != parent; cell += step)
+        {
+            position--;
+            if (position < max_length)
+            {
+                path[position] = cell;
+            }
+        }
+    }
+
+    return length;
+}
+
+// A rectangle of cells, from (x0, y0) up to but not including (x1, y1), which a search may not leave.
+typedef struct
+{
+    int x0, y0, x1, y1;
+} PathRegion;
+
+// Add the A* successors of node: every neighbour inside region which can be stepped to, at the cost of entering it.
+// A reverse search runs backwards from its goal, so each step costs as much as entering node instead.
+// With a goal_x of -1 there is no heuristic, which makes the search Dijkstra's algorithm.
+static void expand_astar(PathArena *arena, const PathGrid *grid, const PathRegion *region, int node, int goal_x, int goal_y, bool reverse)
+{
+    int width = grid->width;
+    int x = node % width;
+    int y = node / width;
+
+    for (int i = 0; i < 8; i++)
+    {
+        int dx = neighbour_dx[i];
+        int dy = neighbour_dy[i];
+
+        if (x + dx < region->x0 || y + dy < region->y0 || x + dx >= region->x1 || y + dy >= region->y1 || !path_can_step(grid, x, y, dx, dy))
+        {
+            continue;
+        }
+
+        int next = node + dy * width + dx;
+        int step = (dx != 0 && dy != 0) ? PATH_DIAGONAL_COST : PATH_STRAIGHT_COST;
+        int g = arena->g[node] + step * grid->cost[reverse ? node : next];
+        int h = goal_x == -1 ? 0 : path_heuristic(x + dx, y + dy, goal_x, goal_y);
+
+        relax(arena, next, g, h, node);
+    }
+}
+
+// Search outwards from start without leaving region, until goal is taken off the open list, or until every reachable
+// cell has been if goal is -1. Returns true if goal was reached.
+static bool search_region(PathArena *arena, const PathGrid *grid, const PathRegion *region, int start, int goal, bool reverse)
+{
+    int goal_x = goal == -1 ? -1 : goal % grid->width;
+    int goal_y = goal == -1 ? -1 : goal / grid->width;
+
+    begin_search(arena, grid->width * grid->height);
+    relax(arena, start, 0, 0, start);
+
+    while (arena->heap_size > 0)
+    {
+        int node = heap_pop(arena);
+        arena->expanded++;
+
+        if (node == goal)
+        {
+            return true;
+        }
+
+        expand_astar(arena, grid, region, node, goal_x, goal_y, reverse);
+    }
+
+    return false;
+}
+
+// Travel from (x, y) in direction (dx, dy) until reaching a jump point: the goal, or a cell where an optimal path might turn.
+// Returns the cell index of the jump point, or -1 if the line runs into a wall first. Diagonal moves may not cut corners, so
+// a diagonal line turns into straight lines wherever it passes an obstacle, and stops where either of its straight components finds a jump point.
+static int jump(const PathGrid *grid, int x, int y, int dx, int dy, int goal_x, int goal_y)
+{
+    while (path_walkable(grid, x, y))
+    {
+        if (x == goal_x && y == goal_y)
+        {
+            return y * grid->width + x;
+        }
+
+        if (dx != 0 && dy != 0)
+        {
+            if (jump(grid, x + dx, y, dx, 0, goal_x, goal_y) != -1 || jump(grid, x, y + dy, 0, dy, goal_x, goal_y) != -1)
+            {
+                return y * grid->width + x;
+            }
+        }
+        else if (dx != 0)
+        {
+            if ((path_walkable(grid, x, y - 1) && !path_walkable(grid, x - dx, y - 1)) || (path_walkable(grid, x, y + 1) && !path_walkable(grid, x - dx, y + 1)))
+            {
+                return y * grid->width + x;
+            }
+        }
+        else
+        {
+            if ((path_walkable(grid, x - 1, y) && !path_walkable(grid, x - 1, y - dy)) || (path_walkable(grid, x + 1, y) && !path_walkable(grid, x + 1, y - dy)))
+            {
+                return y * grid->width + x;
+            }
+        }
+
+        if (!path_walkable(grid, x + dx, y) || !path_walkable(grid, x, y + dy))
+        {
+            return -1;
+        }
+
+        x += dx;
+        y += dy;
+    }
+
+    return -1;
+}
+
+// Add the Jump Point Search successors of node. Only the neighbours an optimal path could continue to from the direction
+// it arrived in are considered, and from each of those the search jumps ahead to the next jump point.
+static void expand_jps(PathArena *arena, const PathGrid *grid, int node, int start, int goal_x, int goal_y)
+{
+    int width = grid->width;
+    int x = node % width;
+    int y = node / width;
+    int directions[8][2];
+    int count = 0;
+
+    if (node == start)
+    {
+        for (int i = 0; i < 8; i++)
+        {
+            directions[count][0] = neighbour_dx[i];
+            directions[count][1] = neighbour_dy[i];
+            count++;
+        }
+    }
+    else
+    {
+        int parent = arena->parent[node];
+        int dx = sign(x - parent % width);
+        int dy = sign(y - parent / width);
+
+        if (dx != 0 && dy != 0)
+        {
+            int directions_diagonal[3][2] = {{0, dy}, {dx, 0}, {dx, dy}};
+            for (int i = 0; i < 3; i++)
+            {
+                directions[count][0] = directions_diagonal[i][0];
+                directions[count][1] = directions_diagonal[i][1];
+                count++;
+            }
+        }
+        else
+        {
+            // A straight jump only stops where a wall beside the line ends, so every open sideways and forward diagonal
+            // neighbour is a possible turn.
+            int side_x = dy, side_y = dx;
+            int directions_straight[5][2] = {{dx, dy}, {dx + side_x, dy + side_y}, {dx - side_x, dy - side_y}, {side_x, side_y}, {-side_x, -side_y}};
+            for (int i = 0; i < 5; i++)
+            {
+                directions[count][0] = directions_straight[i][0];
+                directions[count][1] = directions_straight[i][1];
+                count++;
+            }
+        }
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        int dx = directions[i][0];
+        int dy = directions[i][1];
+
+        if (!path_can_step(grid, x, y, dx, dy))
+        {
+            continue;
+        }
+
+        int next = jump(grid, x + dx, y + dy, dx, dy, goal_x, goal_y);
+        if (next == -1)
+        {
+            continue;
+        }
+
+        int next_x = next % width;
+        int next_y = next / width;
+        int g = arena->g[node] + path_heuristic(x, y, next_x, next_y);
+
+        relax(arena, next, g, path_heuristic(next_x, next_y, goal_x, goal_y), node);
+    }
+}
+
+int path_find(PathArena *arena, const PathGrid *grid, PathMode mode, int start_x, int start_y, int goal_x, int goal_y, int *path, int max_length)
+{
+    if (!path_walkable(grid, start_x, start_y) || !path_walkable(grid, goal_x, goal_y))
+    {
+        return -1;
+    }
+
+    int width = grid->width;
+    int start = start_y * width + start_x;
+    int goal = goal_y * width + goal_x;
+    PathRegion whole = {0, 0, grid->width, grid->height};
+
+    begin_search(arena, grid->width * grid->height);
+    relax(arena, start, 0, path_heuristic(start_x, start_y, goal_x, goal_y), start);
+
+    while (arena->heap_size > 0)
+    {
+        int node = heap_pop(arena);
+        arena->expanded++;
+
+        if (node == goal)
+        {
+            return trace_path(arena, width, start, goal, path, max_length);
+        }
+
+        if (mode == PATH_JPS)
+        {
+            expand_jps(arena, grid, node, start, goal_x, goal_y);
+        }
+        else
+        {
+            expand_astar(arena, grid, &whole, node, goal_x, goal_y, false);
+        }
+    }
+
+    return -1;
+}
+
+// Index of the cluster containing cell.
+static int cluster_of(const PathHierarchy *hierarchy, int cell)
+{
+    int x = cell % hierarchy->width;
+    int y = cell / hierarchy->width;
+
+    return (y / hierarchy->cluster_size) * hierarchy->clusters_x + x / hierarchy->cluster_size;
+}
+
+// The smallest region covering clusters a and b.
+static PathRegion cluster_region(const PathHierarchy *hierarchy, int a, int b)
+{
+    int size = hierarchy->cluster_size;
+    int ax = a % hierarchy->clusters_x, ay = a / hierarchy->clusters_x;
+    int bx = b % hierarchy->clusters_x, by = b / hierarchy->clusters_x;
+    PathRegion region = {(ax < bx ? ax : bx) * size, (ay < by ? ay : by) * size, ((ax > bx ? ax : bx) + 1) * size, ((ay > by ? ay : by) + 1) * size};
+
+    if (region.x1 > hierarchy->width)
+    {
+        region.x1 = hierarchy->width;
+    }
+    if (region.y1 > hierarchy->height)
+    {
+        region.y1 = hierarchy->height;
+    }
+
+    return region;
+}
+
+// Edges of the abstract graph in the order they are found, before they are grouped by the node they leave.
+typedef struct
+{
+    int count;
+    int *from, *to, *cost;
+} EdgeList;
+
+static void add_edge(EdgeList *edges, int from, int to, int cost)
+{
+    edges->from[edges->count] = from;
+    edges->to[edges->count] = to;
+    edges->cost[edges->count] = cost;
+    edges->count++;
+}
+
+// Returns the node standing for cell, adding one if there is none yet.
+static int hierarchy_node(PathHierarchy *hierarchy, int *node_of_cell, int cell)
+{
+    if (node_of_cell[cell] == -1)
+    {
+        node_of_cell[cell] = hierarchy->node_count;
+        hierarchy->node_cell[hierarchy->node_count] = cell;
+        hierarchy->node_count++;
+    }
+
+    return node_of_cell[cell];
+}
+
+// Add the entrances of a border length cells long, starting at (x, y) and running in direction (dx, dy), with the other
+// side of the border offset by (dy, dx). Each entrance joins the nodes either side of it with an edge each way.
+static void add_entrances(PathHierarchy *hierarchy, const PathGrid *grid, int *node_of_cell, EdgeList *edges, int x, int y, int dx, int dy, int length)
+{
+    int run = 0;
+
+    for (int i = 0; i <= length; i++)
+    {
+        if (i < length && path_walkable(grid, x + i * dx, y + i * dy) && path_walkable(grid, x + i * dx + dy, y + i * dy + dx))
+        {
+            run++;
+            continue;
+        }
+
+        if (run > 0)
+        {
+            int first = i - run, last = i - 1;
+            int entrances[2] = {(first + last) / 2, last};
+            int count = 1;
+
+            if (run >= ENTRANCE_SPLIT)
+            {
+                entrances[0] = first;
+                count = 2;
+            }
+
+            for (int j = 0; j < count; j++)
+            {
+                int near = (y + entrances[j] * dy) * grid->width + x + entrances[j] * dx;
+                int far = near + dx * grid->width + dy;
+                int a = hierarchy_node(hierarchy, node_of_cell, near);
+                int b = hierarchy_node(hierarchy, node_of_cell, far);
+
+                add_edge(edges, a, b, PATH_STRAIGHT_COST * grid->cost[far]);
+                add_edge(edges, b, a, PATH_STRAIGHT_COST * grid->cost[near]);
+            }
+        }
+
+        run = 0;
+    }
+}
+
+// Release the abstract graph, keeping the search arenas.
+static void free_graph(PathHierarchy *hierarchy)
+{
+    free(hierarchy->node_cell);
+    free(hierarchy->node_cluster);
+    free(hierarchy->edge_start);
+    free(hierarchy->edge_target);
+    free(hierarchy->edge_cost);
+    free(hierarchy->cluster_start);
+    free(hierarchy->cluster_nodes);
+    free(hierarchy->start_cost);
+    free(hierarchy->goal_cost);
+}
+
+void path_hierarchy_build(PathHierarchy *hierarchy, const PathGrid *grid, int cluster_size)
+{
+    int width = grid->width, height = grid->height;
+
+    free_graph(hierarchy);
+    hierarchy->width = width;
+    hierarchy->height = height;
+    hierarchy->cluster_size = cluster_size;
+    hierarchy->clusters_x = (width + cluster_size - 1) / cluster_size;
+    hierarchy->clusters_y = (height + cluster_size - 1) / cluster_size;
+    hierarchy->node_count = 0;
+
+    int clusters = hierarchy->clusters_x * hierarchy->clusters_y;
+
+    // Every entrance is a pair of cells across a border, and adds at most two nodes and two edges.
+    int border_cells = (hierarchy->clusters_x - 1) * height + (hierarchy->clusters_y - 1) * width;
+    int *node_of_cell = malloc(width * height * sizeof(int));
+    EdgeList edges = {0, malloc(2 * border_cells * sizeof(int)), malloc(2 * border_cells * sizeof(int)), malloc(2 * border_cells * sizeof(int))};
+
+    hierarchy->node_cell = malloc(2 * border_cells * sizeof(int));
+    for (int i = 0; i < width * height; i++)
+    {
+        node_of_cell[i] = -1;
+    }
+
+    for (int cluster_y = 0; cluster_y < hierarchy->clusters_y; cluster_y++)
+    {
+        for (int cluster_x = 0; cluster_x < hierarchy->clusters_x; cluster_x++)
+        {
+            PathRegion region = cluster_region(hierarchy, cluster_y * hierarchy->clusters_x + cluster_x, cluster_y * hierarchy->clusters_x + cluster_x);
+
+            if (region.x1 < width)
+            {
+                add_entrances(hierarchy, grid, node_of_cell, &edges, region.x1 - 1, region.y0, 0, 1, region.y1 - region.y0);
+            }
+            if (region.y1 < height)
+            {
+                add_entrances(hierarchy, grid, node_of_cell, &edges, region.x0, region.y1 - 1, 1, 0, region.x1 - region.x0);
+            }
+        }
+    }
+
+    // Group the nodes by cluster.
+    int node_count = hierarchy->node_count;
+    int *position = malloc((clusters > node_count ? clusters : node_count) * sizeof(int));
+
+    hierarchy->node_cluster = malloc(node_count * sizeof(int));
+    hierarchy->cluster_start = calloc(clusters + 1, sizeof(int));
+    hierarchy->cluster_nodes = malloc(node_count * sizeof(int));
+
+    for (int i = 0; i < node_count; i++)
+    {
+        hierarchy->node_cluster[i] = cluster_of(hierarchy, hierarchy->node_cell[i]);
+        hierarchy->cluster_start[hierarchy->node_cluster[i] + 1]++;
+    }
+    for (int c = 0; c < clusters; c++)
+    {
+        hierarchy->cluster_start[c + 1] += hierarchy->cluster_start[c];
+        position[c] = hierarchy->cluster_start[c];
+    }
+    for (int i = 0; i < node_count; i++)
+    {
+        hierarchy->cluster_nodes[position[hierarchy->node_cluster[i]]++] = i;
+    }
+
+    // Join every pair of nodes in the same cluster, at the cost of the cheapest path between them inside the cluster.
+    int intra_edges = 0;
+    for (int c = 0; c < clusters; c++)
+    {
+        int nodes = hierarchy->cluster_start[c + 1] - hierarchy->cluster_start[c];
+        intra_edges += nodes * (nodes - 1);
+    }
+
+    edges.from = realloc(edges.from, (edges.count + intra_edges) * sizeof(int));
+    edges.to = realloc(edges.to, (edges.count + intra_edges) * sizeof(int));
+    edges.cost = realloc(edges.cost, (edges.count + intra_edges) * sizeof(int));
+
+    PathArena *arena = &hierarchy->cells;
+
+    for (int c = 0; c < clusters; c++)
+    {
+        PathRegion region = cluster_region(hierarchy, c, c);
+
+        for (int i = hierarchy->cluster_start[c]; i < hierarchy->cluster_start[c + 1]; i++)
+        {
+            int from = hierarchy->cluster_nodes[i];
+            search_region(arena, grid, &region, hierarchy->node_cell[from], -1, false);
+
+            for (int j = hierarchy->cluster_start[c]; j < hierarchy->cluster_start[c + 1]; j++)
+            {
+                int to = hierarchy->cluster_nodes[j];
+                int cell = hierarchy->node_cell[to];
+
+                if (to != from && arena->stamp[cell] == arena->search)
+                {
+                    add_edge(&edges, from, to, arena->g[cell]);
+                }
+            }
+        }
+    }
+
+    // Group the edges by the node they leave.
+    hierarchy->edge_start = calloc(node_count + 1, sizeof(int));
+    hierarchy->edge_target = malloc(edges.count * sizeof(int));
+    hierarchy->edge_cost = malloc(edges.count * sizeof(int));
+
+    for (int i = 0; i < edges.count; i++)
+    {
+        hierarchy->edge_start[edges.from[i] + 1]++;
+    }
+    for (int i = 0; i < node_count; i++)
+    {
+        hierarchy->edge_start[i + 1] += hierarchy->edge_start[i];
+        position[i] = hierarchy->edge_start[i];
+    }
+    for (int i = 0; i < edges.count; i++)
+    {
+        int j = position[edges.from[i]]++;
+        hierarchy->edge_target[j] = edges.to[i];
+        hierarchy->edge_cost[j] = edges.cost[i];
+    }
+
+    hierarchy->start_cost = malloc(node_count * sizeof(int));
+    hierarchy->goal_cost = malloc(node_count * sizeof(int));
+
+    free(position);
+    free(node_of_cell);
+    free(edges.from);
+    free(edges.to);
+    free(edges.cost);
+}
+
+void path_hierarchy_free(PathHierarchy *hierarchy)
+{
+    free_graph(hierarchy);
+    path_arena_free(&hierarchy->cells);
+    path_arena_free(&hierarchy->nodes);
+    *hierarchy = (PathHierarchy){0};
+}
+
+// Record in cost the cost of the cheapest path inside cluster from cell to each of its nodes, or with reverse set,
+// from each of its nodes to cell.
+static void connect_to_cluster(PathHierarchy *hierarchy, const PathGrid *grid, int cell, int cluster, int *cost, bool reverse)
+{
+    PathArena *arena = &hierarchy->cells;
+    PathRegion region = cluster_region(hierarchy, cluster, cluster);
+
+    search_region(arena, grid, &region, cell, -1, reverse);
+    hierarchy->expanded += arena->expanded;
+
+    for (int i = hierarchy->cluster_start[cluster]; i < hierarchy->cluster_start[cluster + 1]; i++)
+    {
+        int node = hierarchy->cluster_nodes[i];
+        int node_cell = hierarchy->node_cell[node];
+
+        cost[node] = arena->stamp[node_cell] == arena->search ? arena->g[node_cell] : -1;
+    }
+}
+
+int path_hierarchy_find(PathHierarchy *hierarchy, const PathGrid *grid, int start_x, int start_y, int goal_x, int goal_y, int *waypoints, int max_waypoints)
+{
+    hierarchy->expanded = 0;
+
+    if (!path_walkable(grid, start_x, start_y) || !path_walkable(grid, goal_x, goal_y))
+    {
+        return -1;
+    }
+
+    int start = start_y * grid->width + start_x;
+    int goal = goal_y * grid->width + goal_x;
+
+    if (start == goal)
+    {
+        return 0;
+    }
+
+    int start_cluster = cluster_of(hierarchy, start);
+    int goal_cluster = cluster_of(hierarchy, goal);
+
+    // Within one cluster, take a path which stays inside it if there is one.
+    if (start_cluster == goal_cluster)
+    {
+        PathRegion region = cluster_region(hierarchy, start_cluster, start_cluster);
+        bool found = search_region(&hierarchy->cells, grid, &region, start, goal, false);
+
+        hierarchy->expanded += hierarchy->cells.expanded;
+        if (found)
+        {
+            if (max_waypoints > 0)
+            {
+                waypoints[0] = goal;
+            }
+            return 1;
+        }
+    }
+
+    connect_to_cluster(hierarchy, grid, start, start_cluster, hierarchy->start_cost, false);
+    connect_to_cluster(hierarchy, grid, goal, goal_cluster, hierarchy->goal_cost, true);
+
+    // The start and goal join the abstract graph as two extra nodes, numbered after the others.
+    PathArena *arena = &hierarchy->nodes;
+    int start_node = hierarchy->node_count;
+    int goal_node = hierarchy->node_count + 1;
+    bool found = false;
+
+    begin_search(arena, hierarchy->node_count + 2);
+    relax(arena, start_node, 0, 0, start_node);
+
+    while (arena->heap_size > 0 && !found)
+    {
+        int node = heap_pop(arena);
+        arena->expanded++;
+
+        if (node == goal_node)
+        {
+            found = true;
+        }
+        else if (node == start_node)
+        {
+            for (int i = hierarchy->cluster_start[start_cluster]; i < hierarchy->cluster_start[start_cluster + 1]; i++)
+            {
+                int next = hierarchy->cluster_nodes[i];
+                int cell = hierarchy->node_cell[next];
+
+                if (hierarchy->start_cost[next] != -1)
+                {
+                    relax(arena, next, hierarchy->start_cost[next], path_heuristic(cell % grid->width, cell / grid->width, goal_x, goal_y), node);
+                }
+            }
+        }
+        else
+        {
+            for (int i = hierarchy->edge_start[node]; i < hierarchy->edge_start[node + 1]; i++)
+            {
+                int next = hierarchy->edge_target[i];
+                int cell = hierarchy->node_cell[next];
+
+                relax(arena, next, arena->g[node] + hierarchy->edge_cost[i], path_heuristic(cell % grid->width, cell / grid->width, goal_x, goal_y), node);
+            }
+
+            if (hierarchy->node_cluster[node] == goal_cluster && hierarchy->goal_cost[node] != -1)
+            {
+                relax(arena, goal_node, arena->g[node] + hierarchy->goal_cost[node], 0, node);
+            }
+        }
+    }
+
+    hierarchy->expanded += arena->expanded;
+
+    if (!found)
+    {
+        return -1;
+    }
+
+    // Nodes on the start or goal cells themselves add nothing to the path, so they are left out.
+    int count = 0;
+    for (int node = arena->parent[goal_node]; node != start_node; node = arena->parent[node])
+    {
+        count += hierarchy->node_cell[node] != start && hierarchy->node_cell[node] != goal;
+    }
+
+    if (count < max_waypoints)
+    {
+        waypoints[count] = goal;
+    }
+
+    int position = count;
+    for (int node = arena->parent[goal_node]; node != start_node; node = arena->parent[node])
+    {
+        if (hierarchy->node_cell[node] != start && hierarchy->node_cell[node] != goal)
+        {
+            position--;
+            if (position < max_waypoints)
+            {
+                waypoints[position] = hierarchy->node_cell[node];
+            }
+        }
+    }
+
+    return count + 1;
+}
+
+int path_hierarchy_refine(PathHierarchy *hierarchy, const PathGrid *grid, int from_x, int from_y, int to_x, int to_y, int *path, int max_length)
+{
+    hierarchy->expanded = 0;
+
+    if (!path_walkable(grid, from_x, from_y) || !path_walkable(grid, to_x, to_y))
+    {
+        return -1;
+    }
+
+    int from = from_y * grid->width + from_x;
+    int to = to_y * grid->width + to_x;
+    PathRegion region = cluster_region(hierarchy, cluster_of(hierarchy, from), cluster_of(hierarchy, to));
+    bool found = search_region(&hierarchy->cells, grid, &region, from, to, false);
+
+    hierarchy->expanded = hierarchy->cells.expanded;
+    return found ? trace_path(&hierarchy->cells, grid->width, from, to, path, max_length) : -1;
+}
+
+void flow_field_reset(FlowField *field, const PathGrid *grid)
+{
+    int cells = grid->width * grid->height;
+
+    if (cells > field->width * field->height)
+    {
+        field->direction = realloc(field->direction, cells);
+        field->next_direction = realloc(field->next_direction, cells);
+        field->distance = realloc(field->distance, cells * sizeof(int));
+        field->next_distance = realloc(field->next_distance, cells * sizeof(int));
+    }
+
+    field->width = grid->width;
+    field->height = grid->height;
+    field->target = -1;
+    field->pending_target = -1;
+    field->latest_target = -1;
+    field->settled = 0;
+
+    for (int i = 0; i < cells; i++)
+    {
+        field->direction[i] = FLOW_NONE;
+        field->distance[i] = -1;
+    }
+
+    path_arena_reserve(&field->search, cells);
+}
+
+void flow_field_free(FlowField *field)
+{
+    free(field->direction);
+    free(field->next_direction);
+    free(field->distance);
+    free(field->next_distance);
+    path_arena_free(&field->search);
+    *field = (FlowField){0};
+}
+
+// Start a rebuild of the field towards target. The field under construction is cleared as the rebuild goes, by flow_field_update().
+static void begin_rebuild(FlowField *field, const PathGrid *grid, int target)
+{
+    begin_search(&field->search, grid->width * grid->height);
+    relax(&field->search, target, 0, 0, target);
+    field->pending_target = target;
+    field->cleared = 0;
+}
+
+void flow_field_set_target(FlowField *field, const PathGrid *grid, int x, int y)
+{
+    if (!path_walkable(grid, x, y))
+    {
+        return;
+    }
+
+    int target = y * grid->width + x;
+    field->latest_target = target;
+
+    if (field->pending_target == -1 && field->target != target)
+    {
+        begin_rebuild(field, grid, target);
+    }
+}
+
+bool flow_field_update(FlowField *field, const PathGrid *grid, int budget)
+{
+    PathArena *search = &field->search;
+    int width = grid->width;
+
+    if (field->pending_target == -1)
+    {
+        return field->target != -1;
+    }
+
+    int cells = field->width * field->height;
+    int settled = 0;
+
+    for (; field->cleared < cells && (budget <= 0 || settled < budget); settled++)
+    {
+        int end = field->cleared + FLOW_CLEAR_CELLS < cells ? field->cleared + FLOW_CLEAR_CELLS : cells;
+
+        for (int i = field->cleared; i < end; i++)
+        {
+            field->next_direction[i] = FLOW_NONE;
+            field->next_distance[i] = -1;
+        }
+        field->cleared = end;
+    }
+
+    for (; field->cleared == cells && search->heap_size > 0 && (budget <= 0 || settled < budget); settled++)
+    {
+        int node = heap_pop(search);
+        int x = node % width;
+        int y = node / width;
+
+        search->expanded++;
+        field->next_distance[node] = search->g[node];
+
+        for (int i = 0; i < 8; i++)
+        {
+            // Searching outwards from the target, so step backwards: a path from the neighbour enters this node.
+            int dx = neighbour_dx[i];
+            int dy = neighbour_dy[i];
+
+            if (!path_can_step(grid, x, y, dx, dy))
+            {
+                continue;
+            }
+
+            int next = node + dy * width + dx;
+            int step = (dx != 0 && dy != 0) ? PATH_DIAGONAL_COST : PATH_STRAIGHT_COST;
+            int g = search->g[node] + step * grid->cost[node];
+
+            if (search->stamp[next] != search->search || (search->heap_index[next] != -1 && g < search->g[next]))
+            {
+                // The neighbour's first step is the reverse of this one, which is neighbour (i ^ 1).
+                field->next_direction[next] = i ^ 1;
+            }
+
+            relax(search, next, g, 0, node);
+        }
+    }
+
+    if (field->cleared < cells || search->heap_size > 0)
+    {
+        return false;
+    }
+
+    unsigned char *direction = field->direction;
+    field->direction = field->next_direction;
+    field->next_direction = direction;
+
+    int *distance = field->distance;
+    field->distance = field->next_distance;
+    field->next_distance = distance;
+
+    field->target = field->pending_target;
+    field->pending_target = -1;
+    field->settled = search->expanded;
+
+    if (field->latest_target != field->target)
+    {
+        // The target moved during the rebuild: head for where it is now with the next one.
+        begin_rebuild(field, grid, field->latest_target);
+        return false;
+    }
+
+    return true;
+}
+
+bool flow_field_step(const FlowField *field, int x, int y, int *dx, int *dy)
+{
+    if (x < 0 || y < 0 || x >= field->width || y >= field->height)
+    {
+        return false;
+    }
+
+    int direction = field->direction[y * field->width + x];
+
+    if (direction == FLOW_NONE)
+    {
+        return false;
+    }
+
+    *dx = neighbour_dx[direction];
+    *dy = neighbour_dy[direction];
+    return true;
+}
+
+int flow_field_distance(const FlowField *field, int x, int y)
+{
+    if (x < 0 || y < 0 || x >= field->width || y >= field->height)
+    {
+        return -1;
+    }
+
+    return field->distance[y * field->width + x];
+}
+
+void distance_map_reset(DistanceMap *map, const PathGrid *grid, int limit)
+{
+    int cells = grid->width * grid->height;
+
+    if (cells > map->width * map->height)
+    {
+        map->sources = realloc(map->sources, cells);
+        map->nearest = realloc(map->nearest, cells * sizeof(int));
+        map->direction = realloc(map->direction, cells);
+        map->distance = realloc(map->distance, cells * sizeof(int));
+        // Removing a source lists every cell it was nearest to, and then the cells its repair reaches.
+        map->changed = realloc(map->changed, 2 * cells * sizeof(int));
+    }
+
+    map->width = grid->width;
+    map->height = grid->height;
+    map->limit = limit;
+    map->touched = 0;
+    map->changed_count = 0;
+
+    for (int i = 0; i < cells; i++)
+    {
+        map->sources[i] = 0;
+        map->nearest[i] = -1;
+        map->direction[i] = FLOW_NONE;
+        map->distance[i] = -1;
+    }
+
+    path_arena_reserve(&map->search, cells);
+}
+
+void distance_map_free(DistanceMap *map)
+{
+    free(map->sources);
+    free(map->nearest);
+    free(map->direction);
+    free(map->distance);
+    free(map->changed);
+    path_arena_free(&map->search);
+    *map = (DistanceMap){0};
+}
+
+// Settle the cells on the open list of the map's search in order of distance. Each passes its nearest source on to any
+// neighbour whose path it makes cheaper without going over the map's limit, which then joins the open list in turn.
+static void spread_distances(DistanceMap *map, const PathGrid *grid)
+{
+    PathArena *search = &map->search;
+    int width = grid->width;
+
+    while (search->heap_size > 0)
+    {
+        int node = heap_pop(search);
+        int x = node % width;
+        int y = node / width;
+
+        map->touched++;
+
+        for (int i = 0; i < 8; i++)
+        {
+            // As in flow_field_update(), a path from the neighbour enters this node.
+            int dx = neighbour_dx[i];
+            int dy = neighbour_dy[i];
+
+            if (!path_can_step(grid, x, y, dx, dy))
+            {
+                continue;
+            }
+
+            int next = node + dy * width + dx;
+            int step = (dx != 0 && dy != 0) ? PATH_DIAGONAL_COST : PATH_STRAIGHT_COST;
+            int g = map->distance[node] + step * grid->cost[node];
+
+            if ((map->limit > 0 && g > map->limit) || (map->distance[next] != -1 && g >= map->distance[next]))
+            {
+                continue;
+            }
+
+            if (search->stamp[next] != search->search)
+            {
+                map->changed[map->changed_count++] = next;
+            }
+
+            map->distance[next] = g;
+            map->nearest[next] = map->nearest[node];
+            map->direction[next] = i ^ 1;
+            relax(search, next, g, 0, node);
+        }
+    }
+}
+
+void distance_map_add_source(DistanceMap *map, const PathGrid *grid, int x, int y)
+{
+    map->touched = 0;
+    map->changed_count = 0;
+
+    if (!path_walkable(grid, x, y))
+    {
+        return;
+    }
+
+    int cell = y * grid->width + x;
+
+    map->sources[cell]++;
+    if (map->sources[cell] > 1)
+    {
+        return;
+    }
+
+    // Only the cells which are now closer to this source than to any other are reached.
+    begin_search(&map->search, grid->width * grid->height);
+    map->distance[cell] = 0;
+    map->nearest[cell] = cell;
+    map->direction[cell] = FLOW_NONE;
+    map->changed[map->changed_count++] = cell;
+    relax(&map->search, cell, 0, 0, cell);
+    spread_distances(map, grid);
+}
+
+// List root and every cell whose first steps lead through it as the first changed cells, and clear their distances.
+// Following first steps leads each cell to its nearest source, so they form a tree, which is walked outwards from root.
+// Without include_root, root itself keeps its distance and is not listed. Returns the number of cells listed.
+static int orphan_subtree(DistanceMap *map, const PathGrid *grid, int root, bool include_root)
+{
+    int width = grid->width;
+    int count = 0;
+
+    map->changed[count++] = root;
+
+    for (int i = 0; i < count; i++)
+    {
+        int node = map->changed[i];
+
+        for (int j = 0; j < 8; j++)
+        {
+            // A neighbour whose first step is the reverse of this one steps into node.
+            if (path_can_step(grid, node % width, node / width, neighbour_dx[j], neighbour_dy[j]) && map->direction[node + neighbour_dy[j] * width + neighbour_dx[j]] == (j ^ 1))
+            {
+                map->changed[count++] = node + neighbour_dy[j] * width + neighbour_dx[j];
+            }
+        }
+    }
+
+    if (!include_root)
+    {
+        map->changed[0] = map->changed[--count];
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        map->distance[map->changed[i]] = -1;
+        map->nearest[map->changed[i]] = -1;
+        map->direction[map->changed[i]] = FLOW_NONE;
+    }
+
+    map->changed_count = count;
+    return count;
+}
+
+// Reconnect the first count changed cells, cleared by orphan_subtree(), through any neighbours which still have a nearest
+// source, and spread from there.
+static void reconnect_orphans(DistanceMap *map, const PathGrid *grid, int count)
+{
+    int width = grid->width;
+
+    begin_search(&map->search, grid->width * grid->height);
+
+    for (int i = 0; i < count; i++)
+    {
+        int node = map->changed[i];
+
+        for (int j = 0; j < 8; j++)
+        {
+            int dx = neighbour_dx[j];
+            int dy = neighbour_dy[j];
+            int next = node + dy * width + dx;
+
+            if (!path_can_step(grid, node % width, node / width, dx, dy) || map->nearest[next] == -1)
+            {
+                continue;
+            }
+
+            int step = (dx != 0 && dy != 0) ? PATH_DIAGONAL_COST : PATH_STRAIGHT_COST;
+            int g = map->distance[next] + step * grid->cost[next];
+
+            if ((map->limit == 0 || g <= map->limit) && (map->distance[node] == -1 || g < map->distance[node]))
+            {
+                map->distance[node] = g;
+                map->nearest[node] = map->nearest[next];
+                map->direction[node] = j;
+                relax(&map->search, node, g, 0, next);
+            }
+        }
+    }
+
+    spread_distances(map, grid);
+    map->touched += count;
+}
+
+void distance_map_remove_source(DistanceMap *map, const PathGrid *grid, int x, int y)
+{
+    map->touched = 0;
+    map->changed_count = 0;
+
+    if (!path_walkable(grid, x, y) || map->sources[y * grid->width + x] == 0)
+    {
+        return;
+    }
+
+    int cell = y * grid->width + x;
+
+    map->sources[cell]--;
+    if (map->sources[cell] > 0)
+    {
+        return;
+    }
+
+    // Every cell whose nearest source was this one has to find another.
+    reconnect_orphans(map, grid, orphan_subtree(map, grid, cell, true));
+}
+
+void distance_map_update_cell(DistanceMap *map, const PathGrid *grid, int x, int y, int old_cost)
+{
+    map->touched = 0;
+    map->changed_count = 0;
+
+    int width = grid->width;
+    int cell = y * width + x;
+
+    if (!path_walkable(grid, x, y) || grid->cost[cell] == old_cost || map->distance[cell] == -1)
+    {
+        return;
+    }
+
+    // The cost of a cell is paid on entering it, so only paths through the cell change, and the cell's own distance does not.
+    if (grid->cost[cell] > old_cost)
+    {
+        // Paths which entered the cell are dearer now, and may be beaten by others.
+        reconnect_orphans(map, grid, orphan_subtree(map, grid, cell, false));
+        return;
+    }
+
+    // Paths entering the cell are cheaper now, and may beat those of its neighbours.
+    begin_search(&map->search, grid->width * grid->height);
+
+    for (int i = 0; i < 8; i++)
+    {
+        int dx = neighbour_dx[i];
+        int dy = neighbour_dy[i];
+        int next = cell + dy * width + dx;
+
+        if (!path_can_step(grid, x, y, dx, dy))
+        {
+            continue;
+        }
+
+        int step = (dx != 0 && dy != 0) ? PATH_DIAGONAL_COST : PATH_STRAIGHT_COST;
+        int g = map->distance[cell] + step * grid->cost[cell];
+
+        if ((map->limit == 0 || g <= map->limit) && (map->distance[next] == -1 || g < map->distance[next]))
+        {
+            map->distance[next] = g;
+            map->nearest[next] = map->nearest[cell];
+            map->direction[next] = i ^ 1;
+            map->changed[map->changed_count++] = next;
+            relax(&map->search, next, g, 0, cell);
+        }
+    }
+
+    spread_distances(map, grid);
+}
+
+bool distance_map_step(const DistanceMap *map, int x, int y, int *dx, int *dy)
+{
+    if (x < 0 || y < 0 || x >= map->width || y >= map->height)
+    {
+        return false;
+    }
+
+    int direction = map->direction[y * map->width + x];
+
+    if (direction == FLOW_NONE)
+    {
+        return false;
+    }
+
+    *dx = neighbour_dx[direction];
+    *dy = neighbour_dy[direction];
+    return true;
+}
+
+int distance_map_distance(const DistanceMap *map, int x, int y)
+{
+    if (x < 0 || y < 0 || x >= map->width || y >= map->height)
+    {
+        return -1;
+    }
+
+    return map->distance[y * map->width + x];
+}
@@ -0,0 +1,229 @@
+#ifndef PATHFIND_H
+#define PATHFIND_H
+
+#include <stdbool.h>
+
+// Cost of a straight and a diagonal step between neighbouring cells, before the cost of the cell entered is applied.
+// Diagonal steps cost roughly sqrt(2) times as much as straight ones.
+#define PATH_STRAIGHT_COST 10
+#define PATH_DIAGONAL_COST 14
+
+// Search algorithm used by path_find().
+// PATH_ASTAR works on any grid. PATH_JPS (Jump Point Search) treats every walkable cell as costing 1, and on open grids
+// expands far fewer nodes than A* by jumping along straight and diagonal lines, only stopping where the path might turn.
+// Both find paths of the same, cheapest cost on grids where every walkable cell costs 1.
+typedef enum
+{
+    PATH_ASTAR,
+    PATH_JPS
+} PathMode;
+
+// The grid searched by the pathfinder. cost[y * width + x] multiplies the cost of every step into cell (x, y);
+// a cost of 0 marks the cell as blocked.
+typedef struct
+{
+    int width, height;
+    unsigned char *cost;
+} PathGrid;
+
+// Working memory for searches, allocated once and reused by every search so that replanning does not allocate.
+// Nodes are reset lazily: each search takes a new stamp, and a node whose stamp differs has not been reached by it yet.
+typedef struct
+{
+    int capacity, heap_size;
+    unsigned int search;
+    unsigned int *stamp;
+    int *g, *f, *parent, *heap, *heap_index;
+
+    // Number of nodes taken off the open list by the most recent search.
+    int expanded;
+} PathArena;
+
+// Make sure the arena can search grids of up to cells cells. Memory is only reallocated when the arena has to grow.
+void path_arena_reserve(PathArena *arena, int cells);
+
+// Release the memory held by the arena.
+void path_arena_free(PathArena *arena);
+
+// Returns true if (x, y) is inside the grid and not blocked.
+bool path_walkable(const PathGrid *grid, int x, int y);
+
+// Returns true if a step from (x, y) by (dx, dy), each -1, 0 or 1, is allowed. Diagonal steps may not cut the corner of a blocked cell.
+bool path_can_step(const PathGrid *grid, int x, int y, int dx, int dy);
+
+// Estimate of the cost from (x1, y1) to (x2, y2) on an open grid (the octile distance), which never overestimates.
+int path_heuristic(int x1, int y1, int x2, int y2);
+
+// Find a cheapest 8-connected path from (start_x, start_y) to (goal_x, goal_y) with the search algorithm given by mode.
+// Writes the first max_length cells of the path into path as indices y * width + x, excluding the start and including the goal.
+// Returns the full length of the path, which may be more than max_length, 0 if the start is the goal, or -1 if the goal cannot be reached.
+int path_find(PathArena *arena, const PathGrid *grid, PathMode mode, int start_x, int start_y, int goal_x, int goal_y, int *path, int max_length);
+
+// A hierarchical view of a grid for HPA* (hierarchical pathfinding A*) on large grids, built once when the grid is loaded.
+//
+// The grid is split into square clusters. Wherever cells on both sides of the border between two clusters are open, the
+// border has entrances, and the cells either side of an entrance become nodes of an abstract graph. Nodes of the same cluster
+// are joined by edges costing the cheapest path between them that stays inside the cluster.
+//
+// A query searches the small abstract graph instead of the grid, and returns waypoints rather than cells. Each leg between
+// waypoints lies within one or two neighbouring clusters, so an agent only needs to refine the leg it is on into cells.
+// Paths are close to the cheapest but not always the cheapest, as they must cross borders at entrances.
+typedef struct
+{
+    int width, height, cluster_size, clusters_x, clusters_y;
+
+    // Abstract graph. Node i stands for cell node_cell[i] of cluster node_cluster[i], and its edges lead to
+    // edge_target[j] at a cost of edge_cost[j] for edge_start[i] <= j < edge_start[i + 1].
+    int node_count;
+    int *node_cell, *node_cluster, *edge_start, *edge_target, *edge_cost;
+
+    // Nodes of cluster c are cluster_nodes[j] for cluster_start[c] <= j < cluster_start[c + 1].
+    int *cluster_start, *cluster_nodes;
+
+    // Cost from the start of the current query to each node of its cluster, and from each node of the goal's cluster
+    // to the goal, or -1 if there is no path within the cluster.
+    int *start_cost, *goal_cost;
+
+    // Working memory for searches of the grid and of the abstract graph.
+    PathArena cells, nodes;
+
+    // Number of nodes, of either kind, taken off the open list by the most recent query or refinement.
+    int expanded;
+} PathHierarchy;
+
+// Build the hierarchy for grid with clusters of cluster_size by cluster_size cells, replacing any built before.
+// Must be called again whenever the grid changes.
+void path_hierarchy_build(PathHierarchy *hierarchy, const PathGrid *grid, int cluster_size);
+
+// Release the memory held by the hierarchy.
+void path_hierarchy_free(PathHierarchy *hierarchy);
+
+// Find a path from (start_x, start_y) to (goal_x, goal_y) through the abstract graph.
+// Writes the first max_waypoints waypoints into waypoints as cell indices y * width + x, excluding the start and ending with the goal.
+// Returns the full number of waypoints, 0 if the start is the goal, or -1 if the goal cannot be reached.
+int path_hierarchy_find(PathHierarchy *hierarchy, const PathGrid *grid, int start_x, int start_y, int goal_x, int goal_y, int *waypoints, int max_waypoints);
+
+// Refine one leg of a hierarchical path, from (from_x, from_y) to the next waypoint (to_x, to_y), into cells.
+// Searches only the clusters containing the two ends, and writes and returns the path in the same way as path_find().
+int path_hierarchy_refine(PathHierarchy *hierarchy, const PathGrid *grid, int from_x, int from_y, int to_x, int to_y, int *path, int max_length);
+
+// Value of FlowField.direction for a cell with no step towards the target: the target itself, or a cell which cannot reach it.
+#define FLOW_NONE 255
+
+// Number of cells of a flow field cleared for a rebuild in the time taken to settle one.
+#define FLOW_CLEAR_CELLS 32
+
+// A flow field: for every cell of a grid, the first step of a cheapest path to a single target cell, and the cost of that path.
+// Any number of agents chasing the same target can share one field, each reading its next step in constant time.
+//
+// The field is built by a Dijkstra search outwards from the target. The search can be spread over several calls with a budget
+// per call, so a large grid does not stall a tick. Until a rebuild finishes, agents keep reading the previous complete field.
+// A field is rebuilt in full whenever its target moves, rather than repaired like a DistanceMap: moving the only target
+// changes the cost of nearly every cell, and repairing it by adding the new target and removing the old one touches about
+// half as many cells again as a rebuild settles, and takes longer. The budget spreads that cost over ticks, but does not
+// reduce it.
+// A rebuild always runs to the end, even if the target moves meanwhile: it then starts again towards the latest target, so
+// a field whose target moves more often than it can be rebuilt still keeps being replaced.
+typedef struct
+{
+    int width, height;
+
+    // Target of the complete field, or -1 if there is none yet, the target of the rebuild in progress, or -1 if none,
+    // and the target most recently asked for, which the next rebuild heads for.
+    int target, pending_target, latest_target;
+
+    // Number of cells of the field under construction cleared so far by the rebuild in progress.
+    int cleared;
+
+    // Complete field: per cell, the index of the first step into the pathfinder's neighbour table (see flow_field_step),
+    // or FLOW_NONE, and the cost of the path, or -1 if the target cannot be reached.
+    unsigned char *direction;
+    int *distance;
+
+    // Field under construction, swapped with the complete field when the rebuild finishes.
+    unsigned char *next_direction;
+    int *next_distance;
+
+    // Search state of the rebuild in progress.
+    PathArena search;
+
+    // Number of cells settled by the most recent complete rebuild.
+    int settled;
+} FlowField;
+
+// Size the field for grid and clear it. Memory is only reallocated when the grid has grown.
+void flow_field_reset(FlowField *field, const PathGrid *grid);
+
+// Release the memory held by the field.
+void flow_field_free(FlowField *field);
+
+// Point the field towards cell (x, y): start rebuilding it if it does not point there already, or, if a rebuild is in
+// progress, rebuild towards (x, y) once that has finished.
+void flow_field_set_target(FlowField *field, const PathGrid *grid, int x, int y);
+
+// Continue the rebuild in progress, settling at most budget cells, or all of them if budget is 0 or less. Clearing the field
+// under construction beforehand counts against the budget too, FLOW_CLEAR_CELLS cells to one settled.
+// Returns true if the field is complete, pointing at the latest target.
+bool flow_field_update(FlowField *field, const PathGrid *grid, int budget);
+
+// Read the first step from (x, y) towards the target of the complete field into dx and dy.
+// Returns false if there is no step to take, either because (x, y) is the target or because it cannot reach the target.
+bool flow_field_step(const FlowField *field, int x, int y, int *dx, int *dy);
+
+// Returns the cost of the path from (x, y) to the target of the complete field, or -1 if the target cannot be reached.
+int flow_field_distance(const FlowField *field, int x, int y);
+
+// A distance map: for every cell of a grid, the cost of the cheapest path to the nearest of any number of source cells,
+// and the first step along it. Adding or removing a source only repairs the cells whose nearest source changes, instead of
+// searching the whole grid again. A map with a limit only reaches cells within that cost of a source, so each change
+// touches a bounded area around it.
+typedef struct
+{
+    int width, height;
+
+    // Cost beyond which cells are left unreached, or 0 for no limit.
+    int limit;
+
+    // Per cell: the number of sources on it, the cell of its nearest source or -1, the first step towards that source as an
+    // index into the pathfinder's neighbour table or FLOW_NONE, and the cost of the path, or -1 if no source can be reached.
+    unsigned char *sources;
+    int *nearest;
+    unsigned char *direction;
+    int *distance;
+
+    // Search state for repairs.
+    PathArena search;
+
+    // Cells whose distance was changed by the most recent change of sources or repair, some possibly listed twice.
+    int *changed;
+    int changed_count;
+
+    // Number of cells checked by the most recent change of sources or repair, for comparing with a rebuild.
+    int touched;
+} DistanceMap;
+
+// Size the map for grid, remove every source, and set its limit. Memory is only reallocated when the grid has grown.
+void distance_map_reset(DistanceMap *map, const PathGrid *grid, int limit);
+
+// Release the memory held by the map.
+void distance_map_free(DistanceMap *map);
+
+// Add a source at (x, y), which may already hold others. Does nothing if the cell is blocked.
+void distance_map_add_source(DistanceMap *map, const PathGrid *grid, int x, int y);
+
+// Remove one source from (x, y). Does nothing if there is none there.
+void distance_map_remove_source(DistanceMap *map, const PathGrid *grid, int x, int y);
+
+// Repair the map after the cost of cell (x, y) in grid has changed from old_cost, like the repairs of D* Lite: only cells
+// whose paths can get cheaper, or whose paths ran through the cell if it got dearer, are searched again.
+// The cell must be walkable both before and after; rebuild the map when cells are blocked or opened.
+void distance_map_update_cell(DistanceMap *map, const PathGrid *grid, int x, int y, int old_cost);
+
+// Read the first step from (x, y) towards its nearest source into dx and dy.
+// Returns false if there is no step to take, either because (x, y) is a source or because it cannot reach one.
+bool distance_map_step(const DistanceMap *map, int x, int y, int *dx, int *dy);
+
+// Returns the cost of the path from (x, y) to its nearest source, or -1 if no source can be reached.
+int distance_map_distance(const DistanceMap *map, int x, int y);
+
+#endif
@@ -0,0 +1,175 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "pool.h"
+
+// Value returned when a steal loses a race with another worker for the last task of a deque, and should be tried again.
+#define POOL_RETRY -2
+
+// Deque of the task numbers from top to bottom - 1, in the manner of the Chase-Lev deque: the owner takes from the bottom
+// and thieves from the top, only needing to agree through an atomic compare-and-swap of top over the last task.
+// No task is pushed once the run starts, so the task numbers themselves are the deque's contents.
+// Each deque has a cache line to itself, so a worker taking its own tasks does not slow down the others.
+typedef struct
+{
+    int top, bottom;
+} __attribute__((aligned(64))) PoolDeque;
+
+typedef struct
+{
+    int workers;
+    PoolDeque *deques;
+    PoolTask task;
+    void *context;
+    int stolen;
+} Pool;
+
+// A worker thread's view of the pool.
+typedef struct
+{
+    Pool *pool;
+    int worker;
+} PoolWorker;
+
+// Take the task at the bottom of the worker's own deque. Returns -1 if it is empty.
+static int take(PoolDeque *deque)
+{
+    int bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_SEQ_CST);
+    int top = __atomic_load_n(&deque->top, __ATOMIC_SEQ_CST);
+
+    if (top < bottom)
+    {
+        return bottom;
+    }
+
+    int task = -1;
+
+    // The last task may be stolen at the same time; whoever moves top past it has it.
+    if (top == bottom && __atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+    {
+        task = bottom;
+    }
+
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return task;
+}
+
+// Steal the task at the top of another worker's deque. Returns -1 if it is empty, or POOL_RETRY if another worker took it first.
+static int steal(PoolDeque *deque)
+{
+    int top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+    if (top >= bottom)
+    {
+        return -1;
+    }
+
+    if (__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+    {
+        return top;
+    }
+
+    return POOL_RETRY;
+}
+
+// Steal a task from any other worker, starting with the next one along. Returns -1 once every deque is empty.
+static int steal_any(Pool *pool, int worker)
+{
+    bool retry = true;
+
+    while (retry)
+    {
+        retry = false;
+
+        for (int i = 1; i < pool->workers; i++)
+        {
+            int task = steal(&pool->deques[(worker + i) % pool->workers]);
+
+            if (task >= 0)
+            {
+                return task;
+            }
+            retry |= task == POOL_RETRY;
+        }
+    }
+
+    return -1;
+}
+
+static void *run_worker(void *data)
+{
+    PoolWorker *self = data;
+    Pool *pool = self->pool;
+
+    for (;;)
+    {
+        int task = take(&pool->deques[self->worker]);
+
+        if (task < 0)
+        {
+            task = steal_any(pool, self->worker);
+            if (task < 0)
+            {
+                break;
+            }
+            __atomic_fetch_add(&pool->stolen, 1, __ATOMIC_RELAXED);
+        }
+
+        pool->task(pool->context, task, self->worker);
+    }
+
+    return NULL;
+}
+
+int pool_run(int workers, int count, PoolTask task, void *context)
+{
+    Pool pool = {workers, NULL, task, context, 0};
+    PoolWorker *selves = malloc(workers * sizeof(PoolWorker));
+    pthread_t *threads = malloc(workers * sizeof(pthread_t));
+    bool *started = calloc(workers, sizeof(bool));
+
+    if (posix_memalign((void **)&pool.deques, sizeof(PoolDeque), workers * sizeof(PoolDeque)) != 0)
+    {
+        abort();
+    }
+
+    for (int i = 0; i < workers; i++)
+    {
+        pool.deques[i].top = (long)count * i / workers;
+        pool.deques[i].bottom = (long)count * (i + 1) / workers;
+        selves[i].pool = &pool;
+        selves[i].worker = i;
+    }
+
+    // A worker whose thread cannot be started leaves its tasks to be stolen by the others.
+    for (int i = 1; i < workers; i++)
+    {
+        started[i] = pthread_create(&threads[i], NULL, run_worker, &selves[i]) == 0;
+    }
+
+    run_worker(&selves[0]);
+
+    for (int i = 1; i < workers; i++)
+    {
+        if (started[i])
+        {
+            pthread_join(threads[i], NULL);
+        }
+    }
+
+    free(pool.deques);
+    free(selves);
+    free(threads);
+    free(started);
+    return pool.stolen;
+}
+
+int pool_processors(void)
+{
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return processors < 1 ? 1 : processors;
+}
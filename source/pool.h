@@ -0,0 +1,21 @@
+#ifndef POOL_H
+#define POOL_H
+
+// A work-stealing thread pool for running many independent tasks, such as whole games, across every core.
+//
+// Tasks are numbered from 0, and each worker starts with an equal run of them in its own deque. A worker takes tasks from
+// the bottom of its own deque, and once that is empty steals from the top of another's, so workers which draw quick tasks
+// help out those which draw slow ones. Each deque is only touched by other workers when they have run out of work.
+
+// A task: run task number index on worker number worker. Workers are numbered from 0, and each runs one task at a time,
+// so tasks can add their results to per-worker totals without locking.
+typedef void (*PoolTask)(void *context, int index, int worker);
+
+// Run tasks 0 to count - 1 on workers threads, the calling thread being worker 0, and return when all have finished.
+// Returns the number of tasks which were stolen from another worker's deque.
+int pool_run(int workers, int count, PoolTask task, void *context);
+
+// Returns the number of processors online, or 1 if it cannot be found.
+int pool_processors(void);
+
+#endif
@@ -0,0 +1,30 @@
+#include "rng.h"
+
+#define RNG_MULTIPLIER 6364136223846793005ULL
+#define RNG_INCREMENT 1442695040888963407ULL
+
+void rng_seed(Rng *rng, uint64_t seed)
+{
+    rng->state = 0;
+    rng->increment = RNG_INCREMENT;
+    rng_next(rng);
+    rng->state += seed;
+    rng_next(rng);
+}
+
+uint32_t rng_next(Rng *rng)
+{
+    uint64_t state = rng->state;
+    rng->state = state * RNG_MULTIPLIER + rng->increment;
+
+    // Output a permutation of the old state: xorshift the high bits down, then rotate by the top 5 bits.
+    uint32_t bits = ((state >> 18) ^ state) >> 27;
+    uint32_t rotation = state >> 59;
+
+    return (bits >> rotation) | (bits << ((-rotation) & 31));
+}
+
+double rng_unit(Rng *rng)
+{
+    return rng_next(rng) / (double)UINT32_MAX;
+}
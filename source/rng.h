@@ -0,0 +1,22 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// State of a PCG32 random number generator (O'Neill's permuted congruential generator). Each simulation owns its own,
+// so runs with the same seed replay exactly, and several can run in parallel threads without sharing a global generator.
+typedef struct
+{
+    uint64_t state, increment;
+} Rng;
+
+// Start the generator at seed. Generators started at the same seed produce the same numbers.
+void rng_seed(Rng *rng, uint64_t seed);
+
+// Returns the next 32 random bits.
+uint32_t rng_next(Rng *rng);
+
+// Returns a random number between 0 and 1 inclusive, like rand() / RAND_MAX.
+double rng_unit(Rng *rng);
+
+#endif
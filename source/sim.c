@@ -0,0 +1,271 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <cab202_timers.h>
+#include "batch.h"
+#include "pool.h"
+#include "sim.h"
+
+__thread int64_t virtual_ns = 0;
+
+double virtual_time(void)
+{
+    return (double)virtual_ns / NANOSECONDS;
+}
+
+void skip_time(long milliseconds)
+{
+    virtual_ns += milliseconds * (NANOSECONDS / MILLISECONDS);
+}
+
+double wall_time(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+bool rooms_readable(char *rooms[], int room_count, const char *program)
+{
+    for (int i = 0; i < room_count; i++)
+    {
+        FILE *stream = fopen(rooms[i], "r");
+        if (stream == NULL)
+        {
+            fprintf(stderr, "%s: cannot open %s\n", program, rooms[i]);
+            return false;
+        }
+        fclose(stream);
+    }
+
+    return true;
+}
+
+bool load_batch_rooms(SimBatch *batch, const char *program)
+{
+    // Every batch of a room shares the same paths, which they only read.
+    batch->loaded = calloc(batch->room_count, sizeof(BatchRoom));
+
+    for (int i = 0; i < batch->room_count; i++)
+    {
+        GameState *game = new_game(ROOM_WIDTH, ROOM_HEIGHT, 1, batch->seed, &default_ai);
+        bool fits;
+
+        advance_game(game, batch->rooms[i], 0);
+        fits = batch_room_init(&batch->loaded[i], game);
+        free_game(game);
+
+        if (!fits)
+        {
+            fprintf(stderr, "%s: %s has %d open cells, more than the %d of a lockstep batch; playing full games\n", program,
+                    batch->rooms[i], batch->loaded[i].count, BATCH_MAX_CELLS);
+            free_batch_rooms(batch);
+            batch->batch_size = 0;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void free_batch_rooms(SimBatch *batch)
+{
+    for (int i = 0; i < batch->room_count && batch->loaded != NULL; i++)
+    {
+        batch_room_free(&batch->loaded[i]);
+    }
+    free(batch->loaded);
+    batch->loaded = NULL;
+}
+
+void play_game(char *rooms[], int room_count, uint64_t seed, int max_seconds, const AiParams *ai, RoomStats *room_stats, SimStats *stats)
+{
+    GameState *game = new_game(ROOM_WIDTH, ROOM_HEIGHT, room_count, seed, ai);
+    game->autoplay = true;
+
+    int64_t game_start = virtual_ns, level_start = virtual_ns;
+    bool timed_out = false;
+    room_stats[0].played++;
+
+    while (!game->level_over)
+    {
+        int level = game->current_level;
+        int lives = game->jerry.lives;
+        int cheese = game->cheese_collected;
+
+        if (level <= room_count && virtual_ns - level_start >= (int64_t)max_seconds * NANOSECONDS)
+        {
+            // Jerry is stuck in this room: give up on it and go on to the next, so every room is played.
+            room_stats[level - 1].timeouts++;
+            timed_out = true;
+            level_end(game, 'N');
+            level_start = virtual_ns;
+
+            if (game->current_level <= room_count)
+            {
+                room_stats[game->current_level - 1].played++;
+            }
+            continue;
+        }
+
+        advance_game(game, level <= room_count ? rooms[level - 1] : NULL, 1);
+        virtual_ns += TICK;
+
+        if (level > room_count)
+        {
+            continue;
+        }
+
+        room_stats[level - 1].seconds += (double)TICK / NANOSECONDS;
+
+        if (game->current_level != level)
+        {
+            // Jerry reached the door, and the next level has begun.
+            room_stats[level - 1].doors++;
+            room_stats[level - 1].door_seconds += (double)(virtual_ns - level_start) / NANOSECONDS;
+            level_start = virtual_ns;
+
+            if (game->current_level <= room_count)
+            {
+                room_stats[game->current_level - 1].played++;
+            }
+        }
+        else if (game->cheese_collected > cheese)
+        {
+            room_stats[level - 1].cheese += game->cheese_collected - cheese;
+        }
+
+        if (game->level_over)
+        {
+            // Jerry lost his last life. Ending the game has already restored his lives for the next one.
+            stats->lives_lost += lives;
+            stats->tom_wins++;
+        }
+        else if (game->jerry.lives < lives)
+        {
+            stats->lives_lost += lives - game->jerry.lives;
+        }
+    }
+
+    if (game->level_over && game->current_level > room_count)
+    {
+        if (timed_out)
+        {
+            stats->timeouts++;
+        }
+        else
+        {
+            stats->jerry_wins++;
+        }
+    }
+
+    stats->games++;
+    stats->seconds += (double)(virtual_ns - game_start) / NANOSECONDS;
+    free_game(game);
+}
+
+void play_batch_game(void *context, int index, int worker)
+{
+    SimBatch *batch = context;
+
+    play_game(batch->rooms, batch->room_count, batch->seed + index, batch->max_seconds, &batch->ai, &batch->room_stats[worker * batch->room_count],
+              &batch->stats[worker]);
+}
+
+void play_lockstep(void *context, int index, int worker)
+{
+    SimBatch *batch = context;
+    int batches = (batch->games + batch->batch_size - 1) / batch->batch_size;
+    int room = index / batches, first = index % batches * batch->batch_size;
+    int count = batch->games - first < batch->batch_size ? batch->games - first : batch->batch_size;
+    int max_steps = batch->max_seconds * MILLISECONDS / DELAY;
+    RoomStats *room_stats = &batch->room_stats[worker * batch->room_count + room];
+    SimStats *stats = &batch->stats[worker];
+    GameBatch games;
+
+    batch_init(&games, &batch->loaded[room], &batch->ai, count, batch->seed + first, room > 0);
+
+    for (int step = 0; step < max_steps && games.playing > 0; step++)
+    {
+        batch_step(&games);
+    }
+
+    for (int k = 0; k < count; k++)
+    {
+        double seconds = (double)games.steps[k] * DELAY / MILLISECONDS;
+
+        room_stats->played++;
+        room_stats->cheese += games.cheese_collected[k];
+        room_stats->seconds += seconds;
+
+        if (games.result[k] == BATCH_JERRY_WON)
+        {
+            room_stats->doors++;
+            room_stats->door_seconds += seconds;
+            stats->jerry_wins++;
+        }
+        else if (games.result[k] == BATCH_TOM_WON)
+        {
+            stats->tom_wins++;
+        }
+        else
+        {
+            room_stats->timeouts++;
+            stats->timeouts++;
+        }
+
+        stats->games++;
+        stats->lives_lost += LIVES - games.lives[k];
+        stats->seconds += seconds;
+    }
+
+    batch_free(&games);
+}
+
+int play_batch(SimBatch *batch, int games, int threads, RoomStats *room_stats, SimStats *stats)
+{
+    batch->room_stats = calloc(threads * batch->room_count, sizeof(RoomStats));
+    batch->stats = calloc(threads, sizeof(SimStats));
+
+    int stolen;
+
+    if (batch->batch_size > 0)
+    {
+        batch->games = games;
+        stolen = pool_run(threads, batch->room_count * ((games + batch->batch_size - 1) / batch->batch_size), play_lockstep, batch);
+    }
+    else
+    {
+        stolen = pool_run(threads, games, play_batch_game, batch);
+    }
+
+    memset(room_stats, 0, batch->room_count * sizeof(RoomStats));
+    memset(stats, 0, sizeof(SimStats));
+
+    for (int i = 0; i < threads; i++)
+    {
+        for (int j = 0; j < batch->room_count; j++)
+        {
+            const RoomStats *worker = &batch->room_stats[i * batch->room_count + j];
+
+            room_stats[j].played += worker->played;
+            room_stats[j].doors += worker->doors;
+            room_stats[j].timeouts += worker->timeouts;
+            room_stats[j].cheese += worker->cheese;
+            room_stats[j].seconds += worker->seconds;
+            room_stats[j].door_seconds += worker->door_seconds;
+        }
+
+        stats->games += batch->stats[i].games;
+        stats->jerry_wins += batch->stats[i].jerry_wins;
+        stats->tom_wins += batch->stats[i].tom_wins;
+        stats->timeouts += batch->stats[i].timeouts;
+        stats->lives_lost += batch->stats[i].lives_lost;
+        stats->seconds += batch->stats[i].seconds;
+    }
+
+    free(batch->room_stats);
+    free(batch->stats);
+    return stolen;
+}
@@ -0,0 +1,101 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "batch.h"
+#include "game.h"
+
+// Headless games for evaluating the automated players, shared by tomjerry-sim and tomjerry-sweep. Games are played without
+// a terminal and on a virtual clock, so they run as fast as the CPU allows, and are shared out between threads by the
+// work-stealing pool. Game i of a batch is seeded with seed + i, so a batch plays the same games however many threads play
+// them. A level on which Jerry spends max_seconds of game time without reaching the door is timed out, and the game goes on
+// to the next room, so every room is played and gets the same time however many come before it. A game with a timed out
+// level which Tom does not go on to win is counted as timed out.
+
+#define GAMES 20
+#define SEED 202
+#define MAX_SECONDS 300
+
+// Size of the terminal the rooms are played on.
+#define ROOM_WIDTH 100
+#define ROOM_HEIGHT 30
+
+// Results for one room, summed over every game which reached it: how often it was played, Jerry reached its door and it
+// timed out, the cheese collected and seconds spent in it, and the seconds to reach the door, summed over every door reached.
+typedef struct
+{
+    int played, doors, timeouts;
+    long cheese;
+    double seconds, door_seconds;
+} RoomStats;
+
+// Results summed over every game. For lockstep batches, each room played is a game of its own, a room-game, which Jerry
+// wins by reaching the door.
+typedef struct
+{
+    int games, jerry_wins, tom_wins, timeouts;
+    long lives_lost;
+    double seconds;
+} SimStats;
+
+// A batch of games to play, and the results of each worker playing them.
+typedef struct
+{
+    char **rooms;
+    int room_count, max_seconds;
+    uint64_t seed;
+
+    // For lockstep batches of batch_size games, the number of games per room and the paths of each room.
+    // With a batch_size of 0, whole games are played through every room instead.
+    int batch_size, games;
+    BatchRoom *loaded;
+
+    // The constants every game of the batch plays by.
+    AiParams ai;
+
+    // Per worker, the results for each room, room_stats[worker * room_count + room], and overall.
+    RoomStats *room_stats;
+    SimStats *stats;
+} SimBatch;
+
+/////////////////////////////////////////////////////
+////////////////FUNC DECLARATIONS////////////////////
+
+// Virtual clock: ZDK reads the time through virtual_time() and pauses through skip_time(), so no game ever waits.
+// Each thread has a clock of its own, as it plays one game at a time.
+double virtual_time(void);
+void skip_time(long milliseconds);
+
+// Returns the wall clock time in seconds, read directly as ZDK's own clock is virtual.
+double wall_time(void);
+
+// Returns true if every room file can be opened, otherwise reports the first which cannot as an error of program.
+bool rooms_readable(char *rooms[], int room_count, const char *program);
+
+// Load each room of the batch and find the paths between its cells, for lockstep batches to share, or release them again.
+// If a room is too large for a lockstep batch (see BATCH_MAX_CELLS), reports it as a warning of program and returns false,
+// with batch_size set to 0 so whole games are played instead.
+bool load_batch_rooms(SimBatch *batch, const char *program);
+void free_batch_rooms(SimBatch *batch);
+
+// Play one game through rooms with both sides automated and governed by ai, one fixed timestep at a time, for at most
+// max_seconds of game time on each level. Adds the results of each room to room_stats, and those of the game to stats.
+void play_game(char *rooms[], int room_count, uint64_t seed, int max_seconds, const AiParams *ai, RoomStats *room_stats, SimStats *stats);
+
+// Pool task: play game number index of the batch, adding its results to those of the worker.
+void play_batch_game(void *context, int index, int worker);
+
+// Pool task: play lockstep batch number index of the batch, counting batches of every room, one room after another.
+// Each room is played as a game of its own, the first room as level 1 and the rest as later levels.
+// Adds the results of its games to those of the worker.
+void play_lockstep(void *context, int index, int worker);
+
+// Play games games of the batch on threads threads, and sum the results of every worker into room_stats and stats.
+// Returns the number of games stolen by one worker from another.
+int play_batch(SimBatch *batch, int games, int threads, RoomStats *room_stats, SimStats *stats);
+
+////////////////FUNC DECLARATIONS////////////////////
+/////////////////////////////////////////////////////
+
+#endif
@@ -0,0 +1,157 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <cab202_timers.h>
+#include "pool.h"
+#include "sim.h"
+
+// Headless simulator for evaluating the automated players. Plays games in which both Tom and Jerry are automated through
+// the rooms given on the command line, one level per room, without a terminal and on a virtual clock, so games run as fast
+// as the CPU allows. Prints how often each side won, how quickly Jerry collects cheese, and how long he takes to reach the
+// door of each room.
+//
+// Usage: tomjerry-sim [-n games] [-s seed] [-t seconds] [-j threads] [-k size] [-S] room files..., for example: ./tomjerry-sim -n 100 ../bin/room*.txt
+// Game i is seeded with seed + i, so a run with the same options plays the same games, however many threads play them.
+// A level on which Jerry spends the given number of seconds of game time is timed out, and the game goes on to the next room;
+// a game with a timed out level which Tom does not go on to win is counted as timed out.
+// Games are shared out between the given number of threads, by default one per processor, by a work-stealing pool.
+// With -S, the games are first played on 1, 2, 4 and so on up to that many threads, to show how the speed scales.
+// With -k, the games are instead played in lockstep batches of that many games (see batch.h), each room as a game of its
+// own, a room-game, the first room as level 1 and the rest as later levels, and results are given in room-games.
+
+/////////////////////////////////////////////////////
+////////////////FUNC DECLARATIONS////////////////////
+
+// Print the results per room and overall, and the speed of the simulation, in room-games if lockstep is set.
+void print_stats(char *rooms[], int room_count, const RoomStats *room_stats, const SimStats *stats, double elapsed, bool lockstep);
+
+////////////////FUNC DECLARATIONS////////////////////
+/////////////////////////////////////////////////////
+
+void print_stats(char *rooms[], int room_count, const RoomStats *room_stats, const SimStats *stats, double elapsed, bool lockstep)
+{
+    const char *games = lockstep ? "room-games" : "games";
+
+    printf("%-22s %8s %8s %8s %12s %12s\n", "room", "played", "doors", "timeouts", "door secs", "cheese/min");
+
+    for (int i = 0; i < room_count; i++)
+    {
+        const RoomStats *room = &room_stats[i];
+        const char *name = strrchr(rooms[i], '/');
+
+        printf("%-22s %8d %8d %8d", name == NULL ? rooms[i] : name + 1, room->played, room->doors, room->timeouts);
+        if (room->doors > 0)
+        {
+            printf(" %12.1f", room->door_seconds / room->doors);
+        }
+        else
+        {
+            printf(" %12s", "-");
+        }
+        printf(" %12.2f\n", room->seconds > 0 ? room->cheese * 60 / room->seconds : 0);
+    }
+
+    printf("\n%d %s: Jerry %s %d (%.1f%%), Tom won %d (%.1f%%), %d timed out; Jerry lost %.2f lives per %s\n", stats->games, games,
+           lockstep ? "reached the door in" : "won", stats->jerry_wins, 100.0 * stats->jerry_wins / stats->games, stats->tom_wins,
+           100.0 * stats->tom_wins / stats->games, stats->timeouts, (double)stats->lives_lost / stats->games, lockstep ? "room-game" : "game");
+    printf("%.0f seconds of game time in %.2f seconds: %.1f %s per second, %.0f times real time\n", stats->seconds, elapsed,
+           stats->games / elapsed, games, stats->seconds / elapsed);
+}
+
+int main(int argc, char *argv[])
+{
+    int games = GAMES, max_seconds = MAX_SECONDS, threads = pool_processors(), batch_size = 0;
+    uint64_t seed = SEED;
+    bool scaling = false;
+    int first_room = 1;
+
+    while (first_room + 1 < argc && argv[first_room][0] == '-')
+    {
+        if (strcmp(argv[first_room], "-S") == 0)
+        {
+            scaling = true;
+            first_room++;
+            continue;
+        }
+        else if (strcmp(argv[first_room], "-n") == 0)
+        {
+            games = atoi(argv[first_room + 1]);
+        }
+        else if (strcmp(argv[first_room], "-s") == 0)
+        {
+            seed = strtoull(argv[first_room + 1], NULL, 10);
+        }
+        else if (strcmp(argv[first_room], "-t") == 0)
+        {
+            max_seconds = atoi(argv[first_room + 1]);
+        }
+        else if (strcmp(argv[first_room], "-j") == 0)
+        {
+            threads = atoi(argv[first_room + 1]);
+        }
+        else if (strcmp(argv[first_room], "-k") == 0)
+        {
+            batch_size = atoi(argv[first_room + 1]);
+        }
+        else
+        {
+            break;
+        }
+        first_room += 2;
+    }
+
+    char **rooms = argv + first_room;
+    int room_count = argc - first_room;
+
+    if (room_count < 1 || games < 1 || max_seconds < 1 || threads < 1 || batch_size < 0)
+    {
+        fprintf(stderr, "usage: tomjerry-sim [-n games] [-s seed] [-t seconds] [-j threads] [-k size] [-S] room files...\n");
+        return 1;
+    }
+
+    if (!rooms_readable(rooms, room_count, "tomjerry-sim"))
+    {
+        return 1;
+    }
+
+    zdk_get_current_time = virtual_time;
+    zdk_timer_pause = skip_time;
+
+    SimBatch batch = {rooms, room_count, max_seconds, seed, batch_size};
+    batch.ai = default_ai;
+
+    if (batch_size > 0 && !load_batch_rooms(&batch, "tomjerry-sim"))
+    {
+        batch_size = 0;
+    }
+    RoomStats *room_stats = calloc(room_count, sizeof(RoomStats));
+    SimStats stats;
+
+    if (scaling)
+    {
+        double single = 0;
+
+        printf("%8s %10s %16s %10s %8s\n", "threads", "seconds", batch_size > 0 ? "room-games/sec" : "games/sec", "speedup", "stolen");
+
+        // 1, 2, 4 and so on, ending with threads itself.
+        for (int i = 1; i <= threads; i = (i < threads && i * 2 > threads) ? threads : i * 2)
+        {
+            double start = wall_time();
+            int stolen = play_batch(&batch, games, i, room_stats, &stats);
+            double elapsed = wall_time() - start;
+
+            single = i == 1 ? elapsed : single;
+            printf("%8d %10.2f %16.1f %9.2fx %8d\n", i, elapsed, stats.games / elapsed, single / elapsed, stolen);
+        }
+        printf("\n");
+    }
+
+    double start = wall_time();
+    play_batch(&batch, games, threads, room_stats, &stats);
+    print_stats(rooms, room_count, room_stats, &stats, wall_time() - start, batch_size > 0);
+
+    free_batch_rooms(&batch);
+    free(room_stats);
+    return 0;
+}
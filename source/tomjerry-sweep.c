@@ -0,0 +1,339 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <cab202_timers.h>
+#include "pool.h"
+#include "rng.h"
+#include "sim.h"
+
+// Parameter sweep over the constants governing the automated players (see AiParams in game.h). Plays the same headless
+// games as tomjerry-sim once for each combination of constants, and writes a line of CSV with the results of each.
+//
+// Usage: tomjerry-sweep [-n games] [-s seed] [-t seconds] [-j threads] [-k size] [-r samples] [-o file] name=low:high[:count]... room files...
+// for example: ./tomjerry-sweep -n 40 chase_speed=0.04:0.12 tom_range=2:10:9 ../bin/room*.txt > sweep.csv
+// Each name=low:high:count varies one constant over count evenly spaced values from low to high, SWEEP_COUNT by default;
+// constants not named keep their defaults. Every combination of values is played, a grid search, unless -r is given, in
+// which case that many combinations are drawn at random, each constant uniformly between low and high.
+// The options are as for tomjerry-sim. Every combination plays the same games, so results differ only by the constants.
+// The mode column tells full games from lockstep batches, with -k, whose games are room-games and whose wins for Jerry
+// are doors reached (see sim.h). The totals are followed by the results of each room, roomN_ for the Nth room given:
+// the times it was played, Jerry reached its door and it timed out, the mean seconds to the door, and cheese per minute.
+// Combinations are played one after another, the games of each shared out between every thread.
+
+#define SWEEP_COUNT 5
+
+// A constant of AiParams which can be swept, at offset bytes into the struct.
+typedef struct
+{
+    const char *name;
+    size_t offset;
+    bool integer;
+} AiField;
+
+// A constant being swept, over count values from low to high.
+typedef struct
+{
+    const AiField *field;
+    double low, high;
+    int count;
+} Sweep;
+
+const AiField ai_fields[] = {
+    {"min_speed", offsetof(AiParams, min_speed), false},
+    {"chase_speed", offsetof(AiParams, chase_speed), false},
+    {"jerry_speed", offsetof(AiParams, jerry_speed), false},
+    {"firework_speed", offsetof(AiParams, firework_speed), false},
+    {"cheese_range", offsetof(AiParams, cheese_range), true},
+    {"door_range", offsetof(AiParams, door_range), true},
+    {"tom_range", offsetof(AiParams, tom_range), true},
+    {"trap_range", offsetof(AiParams, trap_range), true},
+};
+
+#define AI_FIELDS (int)(sizeof(ai_fields) / sizeof(ai_fields[0]))
+
+/////////////////////////////////////////////////////
+////////////////FUNC DECLARATIONS////////////////////
+
+// Parse an argument of the form name=low:high[:count] into sweep. Returns false if it is not one.
+bool parse_sweep(const char *arg, Sweep *sweep);
+
+// Returns the value of field in ai, and sets it, rounding to the nearest whole number for a range.
+double get_ai(const AiParams *ai, const AiField *field);
+void set_ai(AiParams *ai, const AiField *field, double value);
+
+// Set the constants of combination number index of the grid over the sweeps, counting with the last sweep varying fastest.
+void grid_point(AiParams *ai, const Sweep sweeps[], int sweep_count, int index);
+
+// Set the constants of a random combination of the sweeps, drawn from rng.
+void random_point(AiParams *ai, const Sweep sweeps[], int sweep_count, Rng *rng);
+
+// Write a line of CSV with the constants ai and the results of the games played with them, overall and for each of the
+// room_count rooms, in lockstep batches if lockstep is set: the header line if header is set.
+void write_csv(FILE *stream, bool header, const AiParams *ai, bool lockstep, const RoomStats *room_stats, int room_count, const SimStats *stats);
+
+////////////////FUNC DECLARATIONS////////////////////
+/////////////////////////////////////////////////////
+
+bool parse_sweep(const char *arg, Sweep *sweep)
+{
+    const char *equals = strchr(arg, '=');
+
+    if (equals == NULL)
+    {
+        return false;
+    }
+
+    sweep->field = NULL;
+    for (int i = 0; i < AI_FIELDS; i++)
+    {
+        if (strlen(ai_fields[i].name) == (size_t)(equals - arg) && strncmp(arg, ai_fields[i].name, equals - arg) == 0)
+        {
+            sweep->field = &ai_fields[i];
+        }
+    }
+
+    sweep->count = SWEEP_COUNT;
+    int parsed = sscanf(equals + 1, "%lf:%lf:%d", &sweep->low, &sweep->high, &sweep->count);
+
+    return sweep->field != NULL && parsed >= 2 && sweep->count >= 1 && sweep->low <= sweep->high;
+}
+
+double get_ai(const AiParams *ai, const AiField *field)
+{
+    const char *value = (const char *)ai + field->offset;
+    return field->integer ? *(const int *)value : *(const double *)value;
+}
+
+void set_ai(AiParams *ai, const AiField *field, double value)
+{
+    char *target = (char *)ai + field->offset;
+
+    if (field->integer)
+    {
+        *(int *)target = round(value);
+    }
+    else
+    {
+        *(double *)target = value;
+    }
+}
+
+void grid_point(AiParams *ai, const Sweep sweeps[], int sweep_count, int index)
+{
+    for (int i = sweep_count - 1; i >= 0; i--)
+    {
+        int step = index % sweeps[i].count;
+        index /= sweeps[i].count;
+
+        set_ai(ai, sweeps[i].field, sweeps[i].count == 1 ? sweeps[i].low : sweeps[i].low + (sweeps[i].high - sweeps[i].low) * step / (sweeps[i].count - 1));
+    }
+}
+
+void random_point(AiParams *ai, const Sweep sweeps[], int sweep_count, Rng *rng)
+{
+    for (int i = 0; i < sweep_count; i++)
+    {
+        set_ai(ai, sweeps[i].field, sweeps[i].low + (sweeps[i].high - sweeps[i].low) * rng_unit(rng));
+    }
+}
+
+void write_csv(FILE *stream, bool header, const AiParams *ai, bool lockstep, const RoomStats *room_stats, int room_count, const SimStats *stats)
+{
+    if (header)
+    {
+        for (int i = 0; i < AI_FIELDS; i++)
+        {
+            fprintf(stream, "%s,", ai_fields[i].name);
+        }
+        fprintf(stream, "mode,games,jerry_wins,tom_wins,timeouts,lives_lost_per_game,cheese_per_minute,doors,door_seconds,game_seconds");
+        for (int i = 1; i <= room_count; i++)
+        {
+            fprintf(stream, ",room%d_played,room%d_doors,room%d_timeouts,room%d_door_seconds,room%d_cheese_per_minute", i, i, i, i, i);
+        }
+        fprintf(stream, "\n");
+        return;
+    }
+
+    RoomStats total = {0};
+
+    for (int i = 0; i < room_count; i++)
+    {
+        total.doors += room_stats[i].doors;
+        total.cheese += room_stats[i].cheese;
+        total.seconds += room_stats[i].seconds;
+        total.door_seconds += room_stats[i].door_seconds;
+    }
+
+    for (int i = 0; i < AI_FIELDS; i++)
+    {
+        fprintf(stream, ai_fields[i].integer ? "%.0f," : "%g,", get_ai(ai, &ai_fields[i]));
+    }
+
+    // A mean door time of nothing, rather than 0, where Jerry never reached a door.
+    fprintf(stream, "%s,%d,%d,%d,%d,%.3f,%.3f,%d,", lockstep ? "lockstep" : "full", stats->games, stats->jerry_wins, stats->tom_wins, stats->timeouts,
+            (double)stats->lives_lost / stats->games, total.seconds > 0 ? total.cheese * 60 / total.seconds : 0, total.doors);
+    if (total.doors > 0)
+    {
+        fprintf(stream, "%.2f", total.door_seconds / total.doors);
+    }
+    fprintf(stream, ",%.2f", stats->seconds / stats->games);
+
+    for (int i = 0; i < room_count; i++)
+    {
+        const RoomStats *room = &room_stats[i];
+
+        fprintf(stream, ",%d,%d,%d,", room->played, room->doors, room->timeouts);
+        if (room->doors > 0)
+        {
+            fprintf(stream, "%.2f", room->door_seconds / room->doors);
+        }
+        fprintf(stream, ",%.3f", room->seconds > 0 ? room->cheese * 60 / room->seconds : 0);
+    }
+    fprintf(stream, "\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int games = GAMES, max_seconds = MAX_SECONDS, threads = pool_processors(), batch_size = 0, samples = 0;
+    uint64_t seed = SEED;
+    char *output = NULL;
+    int arg = 1;
+
+    while (arg + 1 < argc && argv[arg][0] == '-')
+    {
+        if (strcmp(argv[arg], "-n") == 0)
+        {
+            games = atoi(argv[arg + 1]);
+        }
+        else if (strcmp(argv[arg], "-s") == 0)
+        {
+            seed = strtoull(argv[arg + 1], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "-t") == 0)
+        {
+            max_seconds = atoi(argv[arg + 1]);
+        }
+        else if (strcmp(argv[arg], "-j") == 0)
+        {
+            threads = atoi(argv[arg + 1]);
+        }
+        else if (strcmp(argv[arg], "-k") == 0)
+        {
+            batch_size = atoi(argv[arg + 1]);
+        }
+        else if (strcmp(argv[arg], "-r") == 0)
+        {
+            samples = atoi(argv[arg + 1]);
+        }
+        else if (strcmp(argv[arg], "-o") == 0)
+        {
+            output = argv[arg + 1];
+        }
+        else
+        {
+            break;
+        }
+        arg += 2;
+    }
+
+    Sweep *sweeps = calloc(argc, sizeof(Sweep));
+    int sweep_count = 0;
+
+    while (arg < argc && strchr(argv[arg], '=') != NULL)
+    {
+        if (!parse_sweep(argv[arg], &sweeps[sweep_count]))
+        {
+            fprintf(stderr, "tomjerry-sweep: bad sweep %s\n", argv[arg]);
+            return 1;
+        }
+        sweep_count++;
+        arg++;
+    }
+
+    char **rooms = argv + arg;
+    int room_count = argc - arg;
+
+    if (room_count < 1 || games < 1 || max_seconds < 1 || threads < 1 || batch_size < 0 || samples < 0)
+    {
+        fprintf(stderr, "usage: tomjerry-sweep [-n games] [-s seed] [-t seconds] [-j threads] [-k size] [-r samples] [-o file] "
+                        "name=low:high[:count]... room files...\n");
+        fprintf(stderr, "constants:");
+        for (int i = 0; i < AI_FIELDS; i++)
+        {
+            fprintf(stderr, " %s (%g)", ai_fields[i].name, get_ai(&default_ai, &ai_fields[i]));
+        }
+        fprintf(stderr, "\n");
+        return 1;
+    }
+
+    if (!rooms_readable(rooms, room_count, "tomjerry-sweep"))
+    {
+        return 1;
+    }
+
+    FILE *stream = output == NULL ? stdout : fopen(output, "w");
+    if (stream == NULL)
+    {
+        fprintf(stderr, "tomjerry-sweep: cannot write %s\n", output);
+        return 1;
+    }
+
+    zdk_get_current_time = virtual_time;
+    zdk_timer_pause = skip_time;
+
+    SimBatch batch = {rooms, room_count, max_seconds, seed, batch_size};
+    RoomStats *room_stats = calloc(room_count, sizeof(RoomStats));
+    SimStats stats;
+    Rng rng;
+
+    // Combinations are drawn from a generator of their own, so the games played are the same whatever is swept.
+    rng_seed(&rng, seed);
+
+    if (batch_size > 0 && !load_batch_rooms(&batch, "tomjerry-sweep"))
+    {
+        batch_size = 0;
+    }
+
+    int points = 1;
+    for (int i = 0; i < sweep_count && samples == 0; i++)
+    {
+        points *= sweeps[i].count;
+    }
+    points = samples > 0 ? samples : points;
+
+    write_csv(stream, true, NULL, false, NULL, room_count, NULL);
+
+    for (int i = 0; i < points; i++)
+    {
+        batch.ai = default_ai;
+        if (samples > 0)
+        {
+            random_point(&batch.ai, sweeps, sweep_count, &rng);
+        }
+        else
+        {
+            grid_point(&batch.ai, sweeps, sweep_count, i);
+        }
+
+        double start = wall_time();
+        play_batch(&batch, games, threads, room_stats, &stats);
+        double elapsed = wall_time() - start;
+
+        write_csv(stream, false, &batch.ai, batch_size > 0, room_stats, room_count, &stats);
+        fflush(stream);
+        fprintf(stderr, "%d/%d: %d %s in %.2f seconds, %.1f per second\n", i + 1, points, stats.games,
+                batch_size > 0 ? "room-games" : "games", elapsed, stats.games / elapsed);
+    }
+
+    if (output != NULL)
+    {
+        fclose(stream);
+    }
+    free_batch_rooms(&batch);
+    free(room_stats);
+    free(sweeps);
+    return 0;
+}
@@ -1,34 +1,25 @@
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
-#include <limits.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <time.h>
 #include <cab202_graphics.h>
 #include <cab202_timers.h>
+#include "game.h"
 
-#define DELAY 10
-#define HEIGHT (double)screen_height()
-#define WIDTH (double)screen_width()
-#define MINSPEED 0.1
-#define WALL '*'
+#define MAX_CATCHUP_STEPS 5
 
-#ifndef M_PI
-#define M_PI 3.1415926535897932384626433832795
-#endif
+// Steps run per frame while fast forwarding: one second of game time between frames drawn.
+#define FAST_FORWARD_STEPS 100
 
-bool game_over, level_over, pause;
+// Palette entries of the one ZDK screen, which every game is drawn on.
+int wall_colour, hud_colour, cheese_colour, trap_colour, door_colour;
 
-int setup_players, total_levels;
-int cheese, cheese_collected, traps, trap_supply, fireworks, current_level = 1, current_player;
-int cheese_positions[5][2], trap_positions[5][2], door_position[2];
-double pause_start, pause_end, pause_time, game_time, cheese_time, trap_time, firework_time, STARTTIME;
-struct player
-{
-    int points, lives, level_points;
-    double initx, inity, xpos, ypos, speed, direction;
-    char symbol;
-} jerry, tom, firework;
+// Clock read by ZDK once fast forward has first been used. It runs with the real clock, offset by the game time fast
+// forward has skipped, except while virtual_clock is set, when it stands at virtual_ns and only the main loop moves it.
+bool virtual_clock = false;
+int64_t virtual_ns = 0, real_offset_ns = 0;
 
 /////////////////////////////////////////////////////
 ////////////////FUNC DECLARATIONS////////////////////
@@ -38,118 +29,54 @@ struct player
 /*///////////////*/
 /* Drawing Funcs */
 
-// Draw the room from a specified FILE pointer.
-void draw_room(FILE *stream);
+// Draw the walls recorded in the collision grid into the static layer.
+void draw_room(GameState *game);
 
-// Draws status bar, displaying score, lives, current player and more.
-void draw_hud();
+// Draws status bar, displaying score, lives, current player and more, into the HUD layer.
+// The layer is only redrawn when one of the displayed values has changed.
+void draw_hud(GameState *game);
 
-// Draws the game over screen and waits for either Q or R to (Q)uit the game or (R)estart the level.
-void draw_game_over(char key);
+// Draws the game over screen in the overlay layer and waits for either Q or R to (Q)uit the game or (R)estart the level.
+// The overlay is only drawn once, or again after a resize, so an idle game over screen does no work.
+void draw_game_over(GameState *game, char key);
 
 // Draws Tom and Jerry at their current rounded x and y positions.
-void draw_players();
+void draw_players(GameState *game);
 
 // Draws cheese, traps, fireworks, and the door.
-void draw_objects();
-
-// Executes all drawing functions. Takes a char pointer with the name of the current room's .txt file. This is converted into a FILE* and parsed to draw_room().
-void draw_all(char *current_room);
-
-/* Drawing Funcs */
-/*///////////////*/
-
-/*//////////////*/
-/*Gameplay Funcs*/
-
-// After any point is scored, check_win is called to see if 5 cheese have been collected by Jerry, or Tom has scored 5 points. If so, spawn the Door.
-void check_win();
-
-// Checks is the firework has collided with Tom and handles point calculations. If it hasn't then go to firework_homing to move closer to Tom.
-void update_firework();
-
-// After checking collisions in update_firework(), firework_homing is called to advance the firework's position closer to Tom.
-void firework_homing();
-
-// Check the value of key_pressed; if it is a directional value (WASD) then move the current player.
-// If it is an action value, then shoot a firework, place a trap etc.
-void update_movement(int key_pressed, struct player *plyr);
-
-// Check both cheese and trap collisions at once and perform actions based on the current player.
-void check_cheese_trap_collisions();
-
-// Check the associated collisions with Jerry as a player. i.e. if he collides with cheese, add 1 to his points.
-void check_jerry_collisions();
-
-// Check the associated collisions with Tom as a player. i.e. if he collides with a firework, take 1 away from Tom's lives.
-void check_tom_collisions();
-
-// Update the movement of the current player, as well as check for associated collisions. Parse in the key pressed, and a pointer to the current player.
-void update_player(int key_pressed, struct player *plyr);
-
-// Updates Tom's random movement by calling move_random();
-void update_tom();
-
-// Move the input player (via reference) randomly around the screen,
-// changing speed and direction every time it collides with a wall.
-void move_random(struct player *plyr);
-
-// Move the player automatically with a dx and dy, checking for wall collisions.
-void move_auto_player(struct player *plyr, double dx, double dy);
-
-// Calculate the required x and y movements for Tom to reach Jerry, and parse them into move_auto_player. This function controls Toms "seeking" behaviour.
-void update_tom_advanced();
-
-// Check every cheese's position relative to Jerry. If the cheese is less than 10 units away, then chase_cheese() on that cheese's index in cheese_positions.
-void seek_cheese();
-
-// Tell automated Jerry to chase a specified cheese and index i in the cheese_positions array.
-void chase_cheese(int i);
+void draw_objects(GameState *game);
 
-// If Tom is within 5 units of Jerry, Jerry will run in the opposite direction.
-void escape_tom(double x, double y, double d);
+// Executes all drawing functions. The room is only drawn into the static layer once per level; each frame
+// after that only redraws the entity layer, so show_screen() emits just the cells that changed.
+// Does nothing when ZDK is running as a null renderer.
+void draw_all(GameState *game);
 
-// Update automated Jerry and handle his firewokr shooting, cheese seeking, and Tom avoidance.
-void update_jerry();
+// Moves a position proportionally after the screen has been resized from old_width x old_height, keeping it inside the play area.
+void rescale_position(GameState *game, double *x, double *y, double old_width, double old_height);
 
-// Update the "enemy" player i.e. the current automated player.
-void update_enemy();
+// After a terminal resize, rescale every player and object to the new screen size and schedule the room to be redrawn.
+void fit_to_screen(GameState *game, double old_width, double old_height);
 
-// Checks collisions relative to current player's x and y displacement, with specified symbol.
-int check_collision(struct player plyr, char symbol, double xd, double yd);
-
-// Handle loss of life events.
-void lose_life();
-
-// Place the cheese and traps based on 2 and 3 second intervals respectively. Also only places a trap automatically when Tom is NOT the player.
-void place_cheese_traps();
-
-// Place a trap at Tom's x and y position.
-void place_trap();
-
-// Place a cheese at either a random position on the screen (auto_place == 'A') or at Tom's position (auto_place == 'M').
-void place_cheese(char auto_place);
-
-// Handle the end of the level, either by death or reaching the door.
-// Condition 'Q' goes to game over screen.
-// Condition 'N' goes to the next level.
-void level_end(char condition);
-
-// Performs required pause time calculations.
-void paused();
-
-/*Gameplay Funcs*/
-/*//////////////*/
+/* Drawing Funcs */
+/*///////////////*/
 
 /*Main funcs*/
 /*//////////*/
 
-// Reset all variable back to initial values, including game time, points, lives etc.
-void setup();
+// The monotonic clock read by ZDK once installed by set_virtual_clock, in nanoseconds.
+int64_t clock_ns(void);
+
+// Switch the clock read by ZDK to virtual time, frozen until the main loop moves it on, or back to real time,
+// carrying on from whatever time the clock has reached.
+void set_virtual_clock(bool on);
 
-// Calls all necessary functions for the game's loop, including draw_all, update_player etc.
-// Additonally takes a char* to the current room's .txt file and parses it into draw_all().
-void loop(char *current_room);
+// Add the colour of every kind of object to the ZDK palette, so drawing functions can switch colours without recomputing them.
+void setup_palette(GameState *game);
+
+// Calls all necessary functions for one frame of the game's loop, including draw_all, update_player etc.
+// Additonally takes a char* to the current room's .txt file, which is parsed into load_room() at the start of each level,
+// the number of fixed timesteps the world must advance by to catch up with the game clock, and the key pressed since the last frame, if any.
+void loop(GameState *game, char *current_room, int steps, int key);
 
 /*Main Funcs*/
 /*//////////*/
@@ -160,821 +87,358 @@ void loop(char *current_room);
 /////////////////////////////////////////////////////
 /////////////////DRAWING EVENTS//////////////////////
 
-void draw_room(FILE *stream)
+void draw_room(GameState *game)
 {
-
-    while (!feof(stream))
+    use_palette_colour(wall_colour);
+    for (int y = 0; y < game->grid_height; y++)
     {
-        char command;
-        double x1, y1, x2, y2;
-
-        int arg_count = fscanf(stream, "%c %lf %lf %lf %lf", &command, &x1, &y1, &x2, &y2);
-
-        if (arg_count == 3 && setup_players < 2)
-        {
-            if (command == 'T')
-            {
-                tom.initx = round(x1 * (WIDTH - 1));
-                if (round(y1 * (HEIGHT) + 5) > HEIGHT)
-                {
-                    tom.inity = round(y1 * (HEIGHT)-1);
-                }
-                else
-                {
-                    tom.inity = round(y1 * (HEIGHT) + 5);
-                }
-                tom.xpos = tom.initx;
-                tom.ypos = tom.inity;
-                tom.symbol = 'T';
-                draw_char(tom.xpos, tom.ypos, tom.symbol);
-            }
-            else if (command == 'J')
-            {
-                jerry.initx = round(x1 * (WIDTH - 1));
-                if (round(y1 * (HEIGHT) + 5) > HEIGHT)
-                {
-                    jerry.inity = round(y1 * (HEIGHT)-1);
-                }
-                else
-                {
-                    jerry.inity = round(y1 * (HEIGHT) + 5);
-                }
-                jerry.xpos = jerry.initx;
-                jerry.ypos = jerry.inity;
-                jerry.symbol = 'J';
-                draw_char(jerry.xpos, jerry.ypos, jerry.symbol);
-            }
-            setup_players++;
-        }
-        else if (arg_count == 5)
+        for (int x = 0; x < game->grid_width; x++)
         {
-            if (command == 'W')
+            if (game->room_grid[y * game->grid_width + x] == WALL)
             {
-                draw_line(round(x1 * WIDTH), round(y1 * HEIGHT + 4), round(x2 * WIDTH), round(y2 * HEIGHT + 4), WALL);
+                draw_char(x, y, WALL);
             }
         }
     }
 }
 
-void draw_hud()
+void draw_hud(GameState *game)
 {
     char str_buffer[50];
 
-    draw_string(0, 0, "Student Number: n10214453");
-
-    if (current_player == 'J')
-    {
-        sprintf(str_buffer, "Score: %d", jerry.points);
-    }
-    else
-    {
-        sprintf(str_buffer, "Score: %d", tom.points);
-    }
-    draw_string(10 + WIDTH / 5, 0, str_buffer);
-
-    sprintf(str_buffer, "Lives: %d", current_player == 'J' ? jerry.lives : tom.lives);
-    draw_string(10 + 2 * WIDTH / 5, 0, str_buffer);
-
-    sprintf(str_buffer, "Player: %c", current_player);
-    draw_string(10 + 3 * WIDTH / 5, 0, str_buffer);
-
-    int i_minutes = floor(game_time / 60);
-    double fl_minutes = game_time / 60;
-    double fraction = fl_minutes - floor(fl_minutes);
-    int seconds = 60 * fraction;
+    int game_seconds = game->game_time / NANOSECONDS;
+    int i_minutes = game_seconds / 60;
+    int seconds = game_seconds % 60;
 
-    draw_formatted(10 + 4 * WIDTH / 5, 0, "Time: %02d:%02d", i_minutes, seconds);
+    static int last_state[11];
+    int state[11] = {game->current_player == 'J' ? game->jerry.points : game->tom.points, game->current_player == 'J' ? game->jerry.lives : game->tom.lives, game->current_player, i_minutes, seconds, game->cheese, game->traps, game->fireworks, game->current_level, game->autoplay, game->fast_forward};
 
-    sprintf(str_buffer, "Cheese: %d", cheese);
-    draw_string(0, 3, str_buffer);
-
-    sprintf(str_buffer, "Traps: %d", traps);
-    draw_string(10 + WIDTH / 5, 3, str_buffer);
-
-    sprintf(str_buffer, "Fireworks: %d", fireworks);
-    draw_string(10 + 2 * WIDTH / 5, 3, str_buffer);
-
-    sprintf(str_buffer, "Level: %d", current_level);
-    draw_string(10 + 3 * WIDTH / 5, 3, str_buffer);
-
-    draw_line(0, 4, WIDTH, 4, '-');
-}
-
-void draw_game_over(char key)
-{
-    clear_screen();
-    draw_string(WIDTH / 2 - strlen("---------GAME OVER---------") / 2, HEIGHT / 2, "---------GAME OVER---------");
-    draw_string(WIDTH / 2 - strlen("Press Q to Quit, or R to Restart.") / 2, HEIGHT / 2 + 5, "Press Q to Quit, or R to Restart.");
-    if (key == 'q')
-    {
-        game_over = true;
-    }
-    else if (key == 'r')
+    if (game->room_drawn && memcmp(state, last_state, sizeof(state)) == 0)
     {
-        setup();
-        current_level = 1;
-        jerry.xpos = jerry.initx;
-        jerry.ypos = jerry.inity;
-        tom.xpos = tom.initx;
-        tom.ypos = tom.inity;
+        return;
     }
+    memcpy(last_state, state, sizeof(state));
 
-    show_screen();
-}
+    set_layer(LAYER_HUD);
+    clear_layer(LAYER_HUD);
+    use_palette_colour(hud_colour);
 
-void draw_players()
-{
-    draw_char(round(jerry.xpos), round(jerry.ypos), jerry.symbol);
-    draw_char(round(tom.xpos), round(tom.ypos), tom.symbol);
-}
+    draw_string(0, 0, "Student Number: n10214453");
 
-void draw_objects()
-{
-    for (int i = 0; i < 5; i++)
+    if (game->current_player == 'J')
     {
-        draw_char(cheese_positions[i][0], cheese_positions[i][1], '>');
-        draw_char(trap_positions[i][0], trap_positions[i][1], '#');
+        sprintf(str_buffer, "Score: %d", game->jerry.points);
     }
-
-    draw_char(door_position[0], door_position[1], 'X');
-    draw_char(round(firework.xpos), round(firework.ypos), '~');
-}
-
-void draw_all(char *current_room)
-{
-    clear_screen();
-
-    FILE *stream = fopen(current_room, "r");
-    if (stream != NULL)
+    else
     {
-        draw_room(stream);
-        fclose(stream);
+        sprintf(str_buffer, "Score: %d", game->tom.points);
     }
+    draw_string(10 + WIDTH(game) / 5, 0, str_buffer);
 
-    draw_hud();
-    draw_players();
-    draw_objects();
+    sprintf(str_buffer, "Lives: %d", game->current_player == 'J' ? game->jerry.lives : game->tom.lives);
+    draw_string(10 + 2 * WIDTH(game) / 5, 0, str_buffer);
 
-    show_screen();
-}
-
-/////////////////DRAWING EVENTS//////////////////////
-////////////////////////////////////////////////////
+    sprintf(str_buffer, "Player: %c", game->current_player);
+    draw_string(10 + 3 * WIDTH(game) / 5, 0, str_buffer);
 
-////////////////////////////////////////////////////
-/////////////////GAMEPLAY FUNCTIONS/////////////////
+    draw_formatted(10 + 4 * WIDTH(game) / 5, 0, "Time: %02d:%02d", i_minutes, seconds);
 
-void check_win()
-{
-    if (door_position[0] == -1 && (cheese_collected == 5 || tom.level_points >= 5))
-    {
-        int x, y;
+    sprintf(str_buffer, "Cheese: %d", game->cheese);
+    draw_string(0, 3, str_buffer);
 
-        do
-        {
-            x = round(((double)rand() / (double)RAND_MAX) * (WIDTH - 1));
-            y = round(((double)rand() / (double)RAND_MAX) * (HEIGHT - 4)) + 4;
-        } while (scrape_char(x, y) != ' ');
+    sprintf(str_buffer, "Traps: %d", game->traps);
+    draw_string(10 + WIDTH(game) / 5, 3, str_buffer);
 
-        door_position[0] = x;
-        door_position[1] = y;
-    }
-}
+    sprintf(str_buffer, "Fireworks: %d", game->fireworks);
+    draw_string(10 + 2 * WIDTH(game) / 5, 3, str_buffer);
 
-void firework_homing()
-{
-    double t1 = tom.xpos - firework.xpos;
-    double t2 = tom.ypos - firework.ypos;
-    double d = sqrt(t1 * t1 + t2 * t2);
+    sprintf(str_buffer, "Level: %d", game->current_level);
+    draw_string(10 + 3 * WIDTH(game) / 5, 3, str_buffer);
 
-    double dx = t1 * (0.200 / d);
-    double dy = t2 * (0.200 / d);
+    sprintf(str_buffer, "%s%s", game->autoplay ? "Autoplay " : "", game->fast_forward ? ">>" : "");
+    draw_string(10 + 4 * WIDTH(game) / 5, 3, str_buffer);
 
-    if (firework.xpos + dx < WIDTH - 1 && firework.xpos + dx > 1 && firework.ypos + dy < HEIGHT - 1 && firework.ypos + dy > 5)
-    {
-        if (!check_collision(firework, WALL, dx, 0) && !check_collision(firework, WALL, 0, dy))
-        {
-            firework.xpos += dx;
-            firework.ypos += dy;
-        }
-        else
-        {
-            firework.xpos = -1;
-            firework.ypos = -1;
-            fireworks--;
-        }
-    }
-    else
-    {
-        firework.xpos = -1;
-        firework.ypos = -1;
-        fireworks--;
-    }
+    draw_line(0, 4, WIDTH(game), 4, '-');
 }
 
-void update_firework()
+void draw_game_over(GameState *game, char key)
 {
-    if (round(firework.xpos) == round(tom.xpos) && round(firework.ypos) == round(tom.ypos))
+    if (!game->game_over_drawn)
     {
-        tom.xpos = tom.initx;
-        tom.ypos = tom.inity;
-
-        firework.xpos = -1;
-        firework.ypos = -1;
-        fireworks--;
-
-        if (current_player == 'J')
+        set_layer(LAYER_OVERLAY);
+        use_palette_colour(hud_colour);
+        for (int y = 0; y < HEIGHT(game); y++)
         {
-            jerry.points++;
+            draw_line(0, y, WIDTH(game) - 1, y, ' ');
         }
+        draw_string(WIDTH(game) / 2 - strlen("---------GAME OVER---------") / 2, HEIGHT(game) / 2, "---------GAME OVER---------");
+        draw_string(WIDTH(game) / 2 - strlen("Press Q to Quit, or R to Restart.") / 2, HEIGHT(game) / 2 + 5, "Press Q to Quit, or R to Restart.");
+        game->game_over_drawn = true;
     }
-    else if (firework.xpos != -1 && fireworks > 0 && !pause)
-    {
-        firework_homing();
-    }
-}
 
-void update_movement(int key_pressed, struct player *plyr)
-{
-    plyr->xpos = round(plyr->xpos);
-    plyr->ypos = round(plyr->ypos);
-    if (key_pressed == 'w' && plyr->ypos > 5 && !check_collision(*plyr, WALL, 0, -1))
-    {
-        plyr->ypos -= 1;
-    }
-    else if (key_pressed == 'a' && plyr->xpos > 0 && !check_collision(*plyr, WALL, -1, 0))
-    {
-        plyr->xpos -= 1;
-    }
-    else if (key_pressed == 's' && plyr->ypos < HEIGHT - 1 && !check_collision(*plyr, WALL, 0, 1))
-    {
-        plyr->ypos += 1;
-    }
-    else if (key_pressed == 'd' && plyr->xpos < WIDTH - 1 && !check_collision(*plyr, WALL, 1, 0))
-    {
-        plyr->xpos += 1;
-    }
-    else if (key_pressed == 'p')
-    {
-        paused();
-    }
-    else if (key_pressed == 'f' && firework.xpos == -1 && plyr->symbol == 'J' && current_level > 1)
-    {
-        firework.xpos = jerry.xpos;
-        firework.ypos = jerry.ypos;
-        fireworks++;
-    }
-    else if (key_pressed == 'z' && current_level > 1)
-    {
-        current_player = current_player == 'J' ? 'T' : 'J';
-    }
-    else if (key_pressed == 'm' && current_player == 'T' && traps < 5)
+    if (key == 'q')
     {
-        place_trap();
+        game->game_over = true;
     }
-    else if (key_pressed == 'c' && current_player == 'T' && cheese < 5)
+    else if (key == 'r')
     {
-        place_cheese('M');
+        setup(game);
+        game->current_level = 1;
+        game->jerry.xpos = game->jerry.initx;
+        game->jerry.ypos = game->jerry.inity;
+        game->tom.xpos = game->tom.initx;
+        game->tom.ypos = game->tom.inity;
+        clear_layer(LAYER_OVERLAY);
     }
+
+    show_screen();
 }
 
-void check_cheese_trap_collisions()
+void draw_players(GameState *game)
 {
-    for (int i = 0; i < 5; i++)
-    {
-        if (current_player == 'J')
-        {
-            if (round(jerry.xpos) == cheese_positions[i][0] && round(jerry.ypos) == cheese_positions[i][1])
-            {
-                jerry.points++;
-                cheese_collected++;
-                cheese_positions[i][0] = -1;
-                cheese_positions[i][1] = -1;
-                cheese--;
-
-                check_win();
-            }
-
-            if (round(jerry.xpos) == trap_positions[i][0] && round(jerry.ypos) == trap_positions[i][1])
-            {
-                trap_positions[i][0] = -1;
-                trap_positions[i][1] = -1;
-                traps--;
-                lose_life();
-            }
-        }
-        else
-        {
-            if (round(jerry.xpos) == cheese_positions[i][0] && round(jerry.ypos) == cheese_positions[i][1])
-            {
-                cheese_positions[i][0] = -1;
-                cheese_positions[i][1] = -1;
-                cheese--;
-            }
-
-            if (round(jerry.xpos) == trap_positions[i][0] && round(jerry.ypos) == trap_positions[i][1])
-            {
-                trap_positions[i][0] = -1;
-                trap_positions[i][1] = -1;
-                traps--;
-                tom.points++;
-                tom.level_points++;
-
-                jerry.xpos = jerry.initx;
-                jerry.ypos = jerry.inity;
-
-                check_win();
-            }
-        }
-    }
+    set_layer(LAYER_ENTITIES);
+    use_palette_colour(game->jerry.colour);
+    draw_char(round(game->jerry.xpos), round(game->jerry.ypos), game->jerry.symbol);
+    use_palette_colour(game->tom.colour);
+    draw_char(round(game->tom.xpos), round(game->tom.ypos), game->tom.symbol);
 }
 
-void check_jerry_collisions()
+void draw_objects(GameState *game)
 {
-    if (check_collision(jerry, 'X', 0, 0))
+    use_palette_colour(cheese_colour);
+    for (int i = 0; i < 5; i++)
     {
-        level_end('N');
+        draw_char(game->cheese_positions[i][0], game->cheese_positions[i][1], '>');
     }
 
-    if (check_collision(jerry, 'T', 0, 0))
+    use_palette_colour(trap_colour);
+    for (int i = 0; i < 5; i++)
     {
-        lose_life();
+        draw_char(game->trap_positions[i][0], game->trap_positions[i][1], '#');
     }
 
-    check_cheese_trap_collisions();
+    use_palette_colour(door_colour);
+    draw_char(game->door_position[0], game->door_position[1], 'X');
+    use_palette_colour(game->firework.colour);
+    draw_char(round(game->firework.xpos), round(game->firework.ypos), game->firework.symbol);
 }
 
-void check_tom_collisions()
+void draw_all(GameState *game)
 {
-    if (check_collision(tom, 'J', 0, 0))
+    if (zdk_null_render)
     {
-        tom.points += 5;
-        tom.level_points += 5;
-        check_win();
-        jerry.xpos = jerry.initx;
-        jerry.ypos = jerry.inity;
-        tom.xpos = tom.initx;
-        tom.ypos = tom.inity;
+        return;
     }
 
-    if (check_collision(tom, 'X', 0, 0))
+    if (!game->room_drawn)
     {
-        level_end('N');
+        set_layer(LAYER_STATIC);
+        clear_layer(LAYER_STATIC);
+        draw_room(game);
     }
 
-    if (check_collision(tom, '~', 0, 0))
-    {
-        firework.xpos = -1;
-        firework.ypos = -1;
-        fireworks--;
-        lose_life();
-    }
-}
+    draw_hud(game);
+    game->room_drawn = true;
 
-void update_player(int key_pressed, struct player *plyr)
-{
-    update_movement(key_pressed, plyr);
+    clear_layer(LAYER_ENTITIES);
+    draw_players(game);
+    draw_objects(game);
 
-    if (plyr->symbol == 'J')
-    {
-        check_jerry_collisions();
-    }
-    else
-    {
-        check_tom_collisions();
-    }
+    show_screen();
 }
 
-void update_tom()
+void rescale_position(GameState *game, double *x, double *y, double old_width, double old_height)
 {
-    struct player *plyr = &tom;
-    move_random(plyr);
+    *x = fmax(fmin(round(*x * WIDTH(game) / old_width), WIDTH(game) - 1), 0);
+    *y = fmax(fmin(round(*y * HEIGHT(game) / old_height), HEIGHT(game) - 1), 5);
 }
 
-void move_random(struct player *plyr)
+void fit_to_screen(GameState *game, double old_width, double old_height)
 {
-    double dx = cos(plyr->direction) * plyr->speed;
-    double dy = sin(plyr->direction) * plyr->speed;
-
-    if ((plyr->xpos + dx > WIDTH - 1) || (plyr->xpos + dx < 0) || (plyr->ypos + dy > HEIGHT - 1) || (plyr->ypos + dy < 5) || check_collision(*plyr, WALL, dx, dy) || check_collision(*plyr, WALL, dx, 0) || check_collision(*plyr, WALL, 0, dy))
-    {
-        plyr->speed = (double)rand() / (double)RAND_MAX * MINSPEED + MINSPEED;
-        plyr->direction = ((double)rand() / (double)RAND_MAX) * M_PI * 2;
-    }
-    else
-    {
-        if ((plyr->xpos + dx < WIDTH - 1) && (plyr->xpos + dx > 0))
-        {
-            plyr->xpos += dx;
-        }
-
-        if (plyr->ypos + dy < HEIGHT - 1 && plyr->ypos + dy > 5)
-        {
-            plyr->ypos += dy;
-        }
-    }
-}
+    rescale_position(game, &game->jerry.xpos, &game->jerry.ypos, old_width, old_height);
+    rescale_position(game, &game->jerry.initx, &game->jerry.inity, old_width, old_height);
+    rescale_position(game, &game->tom.xpos, &game->tom.ypos, old_width, old_height);
+    rescale_position(game, &game->tom.initx, &game->tom.inity, old_width, old_height);
 
-void move_auto_player(struct player *plyr, double dx, double dy)
-{
-    if (!check_collision(*plyr, WALL, dx, 0) && !check_collision(*plyr, WALL, 0, dy) && (round(plyr->xpos) + dx < WIDTH - 1) && (round(plyr->xpos) + dx > 0) && (round(plyr->ypos) + dy < HEIGHT - 1) && (round(plyr->ypos) + dy > 5))
-    {
-        plyr->xpos += dx;
-        plyr->ypos += dy;
-    }
-    else if (!check_collision(*plyr, WALL, dx, 0) && (round(plyr->xpos) + dx < WIDTH - 1) && (round(plyr->xpos) + dx > 0))
+    if (game->firework.xpos != -1)
     {
-        plyr->xpos += dx;
+        rescale_position(game, &game->firework.xpos, &game->firework.ypos, old_width, old_height);
     }
-    else if (!check_collision(*plyr, WALL, 0, dy) && (round(plyr->ypos) + dy < HEIGHT - 1) && (round(plyr->ypos) + dy > 5))
-    {
-        plyr->ypos += dy;
-    }
-}
-
-void update_tom_advanced()
-{
-    double t1 = jerry.xpos - tom.xpos;
-    double t2 = jerry.ypos - tom.ypos;
-    double d = sqrt(t1 * t1 + t2 * t2);
-
-    double dx = t1 * (0.08 / d);
-    double dy = t2 * (0.08 / d);
-    struct player *plyr = &tom;
-    move_auto_player(plyr, dx, dy);
-}
-
-void chase_cheese(int i)
-{
-    double x, y, d, dx, dy;
-
-    x = cheese_positions[i][0] - round(jerry.xpos);
-    y = cheese_positions[i][1] - round(jerry.ypos);
-    d = sqrt(x * x + y * y);
-
-    dx = x * (0.1 / d);
-    dy = y * (0.1 / d);
 
-    struct player *plyr = &jerry;
-    move_auto_player(plyr, dx, dy);
-
-    if (round(jerry.xpos) == cheese_positions[i][0] && round(jerry.ypos) == cheese_positions[i][1])
+    int *objects[11];
+    for (int i = 0; i < 5; i++)
     {
-        cheese_positions[i][0] = -1;
-        cheese_positions[i][1] = -1;
-        cheese--;
+        objects[i] = game->cheese_positions[i];
+        objects[5 + i] = game->trap_positions[i];
     }
-}
+    objects[10] = game->door_position;
 
-void seek_cheese()
-{
-    double x_to_cheese, y_to_cheese, d_to_cheese, nearest = WIDTH;
-    int cheese_index = -1;
-    for (int i = 0; i < 5; i++)
+    for (int i = 0; i < 11; i++)
     {
-        if (cheese_positions[i][0] != -1)
+        if (objects[i][0] != -1)
         {
-            x_to_cheese = cheese_positions[i][0] - jerry.xpos;
-            y_to_cheese = cheese_positions[i][1] - jerry.ypos;
-            d_to_cheese = sqrt(x_to_cheese * x_to_cheese + y_to_cheese * y_to_cheese);
-
-            if (d_to_cheese < nearest)
-            {
-                nearest = d_to_cheese;
-                cheese_index = i;
-            }
+            double x = objects[i][0], y = objects[i][1];
+            rescale_position(game, &x, &y, old_width, old_height);
+            objects[i][0] = x;
+            objects[i][1] = y;
         }
     }
 
-    if (cheese_index != -1 && nearest <= 10)
-    {
-        chase_cheese(cheese_index);
-    }
-    else
-    {
-        struct player *plyr = &jerry;
-        move_random(plyr);
-    }
-}
-
-void escape_tom(double x, double y, double d)
-{
-    double dx, dy;
-
-    dx = -x * (0.1 / d);
-    dy = -y * (0.1 / d);
-
-    struct player *plyr = &jerry;
-    move_auto_player(plyr, dx, dy);
+    game->room_loaded = false;
+    game->room_drawn = false;
+    game->game_over_drawn = false;
 }
 
-void update_jerry()
-{
-    double current_time = round(get_current_time());
-    double x_to_tom = tom.xpos - jerry.xpos;
-    double y_to_tom = tom.ypos - jerry.ypos;
-    double d_to_tom = sqrt(x_to_tom * x_to_tom + y_to_tom * y_to_tom);
-
-    if (d_to_tom > 5)
-    {
-        seek_cheese();
-    }
-    else
-    {
-        escape_tom(x_to_tom, y_to_tom, d_to_tom);
-    }
-
-    if (current_time - firework_time == 5 && !pause)
-    {
-        firework.xpos = jerry.xpos;
-        firework.ypos = jerry.ypos;
-        fireworks++;
-        firework_time = round(get_current_time());
-    }
-    else if (pause || current_time - firework_time > 5)
-    {
-        firework_time = round(get_current_time());
-    }
+/////////////////DRAWING EVENTS//////////////////////
+////////////////////////////////////////////////////
 
-    check_cheese_trap_collisions();
-}
+////////////////////////////////////////////////////
 
-void update_enemy()
-{
-    if (!pause)
-    {
-        if (current_player == 'J')
-        {
-            if (current_level == 1)
-            {
-                update_tom();
-            }
-            else
-            {
-                update_tom_advanced();
-            }
-        }
-        else
-        {
-            update_jerry();
-        }
-    }
-}
+////////////////////////////////////////////////////
+//////////////////MAIN FUNCTIONS///////////////////
 
-int check_collision(struct player plyr, char symbol, double xd, double yd)
+void loop(GameState *game, char *current_room, int steps, int key)
 {
-    bool is_colliding = false;
-
-    if (xd > 0)
-    {
-        xd = 1;
-    }
-    else if (xd < 0)
-    {
-        xd = -1;
-    }
-
-    if (yd > 0)
-    {
-        yd = 1;
-    }
-    else if (yd < 0)
-    {
-        yd = -1;
-    }
-
-    if (scrape_char(round(plyr.xpos) + xd, round(plyr.ypos) + yd) == symbol)
+    double old_width = WIDTH(game), old_height = HEIGHT(game);
+    if (screen_resized())
     {
-        is_colliding = true;
+        game->width = screen_width();
+        game->height = screen_height();
+        fit_to_screen(game, old_width, old_height);
     }
 
-    return is_colliding;
-}
+    advance_game(game, current_room, steps);
 
-void paused()
-{
-    pause = !pause;
-    if (pause)
+    if (!game->level_over)
     {
-        pause_start = get_current_time();
-        pause_end = 0;
+        struct player *plyrPntr = game->current_player == 'J' ? &game->jerry : &game->tom;
+        draw_all(game);
+        update_player(game, key, plyrPntr);
     }
     else
     {
-        pause_end = get_current_time();
-        pause_time += pause_end - pause_start;
+        draw_game_over(game, key);
     }
 }
 
-void lose_life()
+int64_t clock_ns(void)
 {
-    jerry.xpos = jerry.initx;
-    jerry.ypos = jerry.inity;
-    tom.xpos = tom.initx;
-    tom.ypos = tom.inity;
-    if (current_player == 'J')
-    {
-        jerry.lives--;
-    }
-    else
+    if (virtual_clock)
     {
-        tom.lives--;
+        return virtual_ns;
     }
 
-    if (jerry.lives == 0 || tom.lives == 0)
-    {
-        level_end('Q');
-    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * NANOSECONDS + now.tv_nsec + real_offset_ns;
 }
 
-void place_cheese_traps()
+void set_virtual_clock(bool on)
 {
-    int current_time = round(get_current_time());
-
-    if (cheese < 5 && current_time - cheese_time == 2 && !pause)
-    {
-        place_cheese('A');
-    }
-    else if (cheese == 5 || pause)
-    {
-        cheese_time = round(get_current_time());
-    }
+    int64_t now = clock_ns();
 
-    if (trap_supply > 0 && current_time - trap_time == 3 && !pause && current_player != 'T')
-    {
-        place_trap();
-    }
-    else if (traps == 5 || pause)
-    {
-        trap_time = round(get_current_time());
-    }
+    virtual_ns = now;
+    virtual_clock = on;
+    real_offset_ns += now - clock_ns();
+    zdk_get_monotonic_ns = clock_ns;
 }
 
-void place_trap()
+void setup_palette(GameState *game)
 {
-    for (int i = 0; i < 5; i++)
-    {
-        if (trap_positions[i][0] == -1)
-        {
-            trap_positions[i][0] = round(tom.xpos);
-            trap_positions[i][1] = round(tom.ypos);
-            traps++;
-            break;
-        }
-    }
-    trap_time = round(get_current_time());
+    wall_colour = add_palette_colour(WHITE, BLACK);
+    hud_colour = add_palette_colour(WHITE, BLACK);
+    game->jerry.colour = add_palette_colour(BRIGHT_YELLOW, BLACK);
+    game->tom.colour = add_palette_colour(BRIGHT_CYAN, BLACK);
+    game->firework.colour = add_palette_colour(BRIGHT_MAGENTA, BLACK);
+    cheese_colour = add_palette_colour(YELLOW, BLACK);
+    trap_colour = add_palette_colour(BRIGHT_RED, BLACK);
+    door_colour = add_palette_colour(BRIGHT_GREEN, BLACK);
 }
 
-void place_cheese(char auto_place)
+int main(int argc, char *argv[])
 {
-    int x, y;
-    if (auto_place == 'A')
-    {
-        x = round(((double)rand() / (double)RAND_MAX) * (WIDTH - 1));
-        y = round(((double)rand() / (double)RAND_MAX) * (HEIGHT - 4)) + 4;
+    // Runs started with the same seed, given as -s seed before the rooms, draw the same random numbers.
+    // -a starts the game playing itself, and -f starts it fast forwarding.
+    uint64_t seed = get_current_time() * NANOSECONDS;
+    bool autoplay = false, fast_forward = false;
 
-        if (scrape_char(x, y) == ' ')
+    while (argc > 1 && argv[1][0] == '-')
+    {
+        if (argc > 2 && strcmp(argv[1], "-s") == 0)
         {
-            for (int i = 0; i < 5; i++)
-            {
-                if (cheese_positions[i][0] == -1)
-                {
-                    cheese_positions[i][0] = x;
-                    cheese_positions[i][1] = y;
-                    cheese++;
-                    break;
-                }
-            }
+            seed = strtoull(argv[2], NULL, 10);
+            argc--;
+            argv++;
         }
-    }
-    else
-    {
-        x = tom.xpos;
-        y = tom.ypos;
-        for (int i = 0; i < 5; i++)
+        else if (strcmp(argv[1], "-a") == 0)
         {
-            if (cheese_positions[i][0] == -1)
-            {
-                cheese_positions[i][0] = x;
-                cheese_positions[i][1] = y;
-                cheese++;
-                break;
-            }
+            autoplay = true;
         }
-    }
-    cheese_time = round(get_current_time());
-}
-
-void level_end(char condition)
-{
-    if (condition == 'Q')
-    {
-        level_over = true;
-        jerry.points = 0;
-        tom.points = 0;
-        jerry.lives = 5;
-        tom.lives = 5;
-    }
-    else if (condition == 'N')
-    {
-        current_level++;
-        setup();
-    }
-}
-/////////////////GAMEPLAY FUNCTIONS/////////////////
-////////////////////////////////////////////////////
-
-////////////////////////////////////////////////////
-//////////////////MAIN FUNCTIONS///////////////////
-
-void loop(char *current_room)
-{
-    int key = get_char();
-
-    if (current_level > total_levels)
-    {
-        level_end('Q');
-    }
-
-    if (!level_over)
-    {
-        double current_time = get_current_time();
-        if (!pause)
+        else if (strcmp(argv[1], "-f") == 0)
         {
-            game_time = current_time - STARTTIME - pause_time;
+            fast_forward = true;
         }
-        struct player *plyrPntr = current_player == 'J' ? &jerry : &tom;
-        update_firework();
-        update_enemy();
-        place_cheese_traps();
-        draw_all(current_room);
-        update_player(key, plyrPntr);
-    }
-    else
-    {
-        draw_game_over(key);
+        else
+        {
+            break;
+        }
+        argc--;
+        argv++;
     }
-}
 
-void setup()
-{
-    srand(get_current_time());
-    STARTTIME = get_current_time();
-
-    game_over = false;
-    level_over = false;
-    pause = false;
-
-    current_player = 'J';
-    setup_players = 0;
-
-    jerry.speed = (double)rand() / (double)RAND_MAX * MINSPEED + MINSPEED;
-    jerry.direction = ((double)rand() / (double)RAND_MAX) * M_PI * 2;
-
-    tom.speed = (double)rand() / (double)RAND_MAX * MINSPEED + MINSPEED;
-    tom.direction = ((double)rand() / (double)RAND_MAX) * M_PI * 2;
-    tom.level_points = 0;
+    setup_screen();
+    GameState *game = new_game(screen_width(), screen_height(), argc - 1, seed, &default_ai);
+    game->autoplay = autoplay;
+    game->fast_forward = fast_forward;
+    setup_palette(game);
+
+    // Fixed timestep: the world advances one step per TICK of game time, however long each frame takes to
+    // compute. A frame that falls behind runs extra steps to catch up, but no more than MAX_CATCHUP_STEPS,
+    // so a slow machine slows the game down rather than falling further and further behind.
+    // Before each frame, wait for either a key press or the next step, so keys are handled as soon as they arrive,
+    // and nothing wakes the game while its clock is paused or the game over screen is showing.
+    // While fast forwarding, the clock is virtual: each frame moves it straight on by FAST_FORWARD_STEPS steps,
+    // so nothing waits and the game runs as fast as it can be computed and drawn.
+    int64_t next_tick = game_clock_ns(game->game_clock);
+
+    while (game->game_over == false)
+    {
+        if (game->fast_forward != virtual_clock)
+        {
+            set_virtual_clock(game->fast_forward);
+        }
 
-    firework.xpos = -1;
-    firework.ypos = -1;
+        int64_t deadline = game_clock_deadline(game->game_clock, next_tick);
+        int max_steps = MAX_CATCHUP_STEPS;
 
-    cheese = 0;
-    cheese_collected = 0;
-    traps = 0;
-    trap_supply = 5;
-    fireworks = 0;
+        if (virtual_clock && deadline != INT64_MAX)
+        {
+            max_steps = FAST_FORWARD_STEPS;
+            virtual_ns = game_clock_deadline(game->game_clock, next_tick + (max_steps - 1) * TICK);
+            deadline = virtual_ns;
+        }
 
-    int reset_objs[5][2] = {{-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}, {-1, -1}};
-    memcpy(cheese_positions, reset_objs, sizeof(reset_objs));
-    memcpy(trap_positions, reset_objs, sizeof(reset_objs));
+        int key = wait_char_until(deadline);
+        int64_t now = game_clock_ns(game->game_clock);
+        int steps = 0;
 
-    int reset_door[2] = {-1, 1};
-    memcpy(door_position, reset_door, sizeof(reset_door));
+        while (now >= next_tick && steps < max_steps)
+        {
+            next_tick += TICK;
+            steps++;
+        }
 
-    pause_time = 0;
-    cheese_time = round(STARTTIME);
-    trap_time = round(STARTTIME);
-    firework_time = round(STARTTIME);
-}
+        if (now >= next_tick)
+        {
+            next_tick = now + TICK;
+        }
 
-int main(int argc, char *argv[])
-{
-    setup_screen();
-    setup();
-    jerry.points = 0;
-    tom.points = 0;
-    jerry.lives = 5;
-    tom.lives = 5;
-    total_levels = argc - 1;
-
-    while (game_over == false)
-    {
-        loop(argv[current_level]);
-        timer_pause(DELAY);
+        loop(game, argv[game->current_level], steps, key);
     }
 
+    free_game(game);
     return 0;
 }
 
 //////////////////MAIN FUNCTIONS///////////////////
-////////////////////////////////////////////////////
\ No newline at end of file
+////////////////////////////////////////////////////